@@ -1,8 +1,40 @@
 #include "bitcointests.h"
 #include "ui_bitcointests.h"
 #include "digest.h"
+#include "crypto/checksum.h"
+#include "crypto/hash160.h"
+#include "crypto/kernels.h"
 #include "vanity.h"
 
+#include <QApplication>
+#include <QClipboard>
+#include <QDir>
+#include <QStandardPaths>
+
+#include <math.h>
+
+/// Where the running vanity search saves its checkpoints
+static QString vanityCheckpointPath()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    return dir + "/vanity.checkpoint";
+}
+
+/// Search ETA as text, e.g. "3 h 20 min"
+static QString formatEta(double seconds)
+{
+    if (!std::isfinite(seconds))
+        return "unknown";
+    if (seconds < 60)
+        return QString("%1 s").arg(seconds, 0, 'f', 0);
+    if (seconds < 3600)
+        return QString("%1 min").arg(seconds / 60, 0, 'f', 0);
+    if (seconds < 86400)
+        return QString("%1 h %2 min").arg(floor(seconds / 3600), 0, 'f', 0).arg(fmod(seconds, 3600) / 60, 0, 'f', 0);
+    return QString("%1 days").arg(seconds / 86400, 0, 'g', 3);
+}
+
 BitcoinTests::BitcoinTests(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::BitcoinTests)
@@ -95,6 +127,13 @@ BitcoinTests::BitcoinTests(QWidget *parent) :
     connect( ui->pushButton_AllVan_Calc,                    SIGNAL(clicked(bool)), this, SLOT(buttonsClicked()) );
     connect( ui->pushButton_AllVan_Rand,                    SIGNAL(clicked(bool)), this, SLOT(buttonsClicked()) );
 
+    connect( ui->pushButton_VanitySearchStart,              SIGNAL(clicked(bool)), this, SLOT(buttonsClicked()) );
+    connect( ui->pushButton_VanitySearchStop,               SIGNAL(clicked(bool)), this, SLOT(buttonsClicked()) );
+    connect( ui->pushButton_VanitySearchStats,              SIGNAL(clicked(bool)), this, SLOT(buttonsClicked()) );
+    connect( ui->pushButton_VanitySearchResume,             SIGNAL(clicked(bool)), this, SLOT(buttonsClicked()) );
+
+    connect( &vanitySearchTimer,                            SIGNAL(timeout()),     this, SLOT(slotVanitySearchTimer()) );
+
 
 }
 
@@ -115,6 +154,7 @@ void BitcoinTests::init(QString version)
     updateAddressTest();
 
     setWindowTitle("Bitcoin Tests " + version);
+    ui->statusBar->showMessage("Hash kernels: " + QString::fromStdString(HashKernelsSummary()));
 }
 
 void BitcoinTests::updatePrivECDSAKey()
@@ -448,6 +488,96 @@ void BitcoinTests::updateAllVanityTest()
 
 }
 
+void BitcoinTests::startVanitySearch()
+{
+    ui->lineEdit_VanitySearchAddress->setText("");
+    ui->lineEdit_VanitySearchPrivKey->setText("");
+
+    // A customer public key turns the search into an additive split-key
+    // one, the key found is then only the partial private key
+    cosmyc::SPLIT_KEY_MODE splitKeyMode = ui->checkBox_VanitySearchMultiplicative->isChecked() ? cosmyc::skMultiplicative : cosmyc::skAdditive;
+    if (!vanitySearch.SetSplitKey(STD_STRING(ui->lineEdit_VanitySearchSplitKey->text().trimmed()), splitKeyMode)) {
+        ui->label_VanitySearchStatus->setText("Invalid customer public key");
+        return;
+    }
+
+    // Several patterns may be given, separated by spaces or commas
+    std::vector<std::string> patterns;
+    for (const QString &pattern : cosmyc::Vanity::SplitPatterns(ui->lineEdit_Pattern->text()))
+        patterns.push_back(STD_STRING(pattern));
+
+    vanitySearch.SetSymmetries(ui->checkBox_VanitySearchSymmetries->isChecked());
+    vanitySearch.SetAutoCheckpoint(STD_STRING(vanityCheckpointPath()), 10);
+
+    int formats = 0;
+    if (ui->checkBox_VanitySearchUncompressed->isChecked())
+        formats |= cosmyc::kfUncompressed;
+    if (ui->checkBox_VanitySearchCompressed->isChecked())
+        formats |= cosmyc::kfCompressed;
+
+    if (!vanitySearch.Start(patterns, 0, cosmyc::KEY_FORMATS(formats))) {
+        ui->label_VanitySearchStatus->setText("Invalid pattern, no key format (bc1q needs compressed keys) or search is already running");
+        return;
+    }
+
+    vanitySearchTimer.start(500);
+    updateVanitySearch();
+}
+
+void BitcoinTests::resumeVanitySearch()
+{
+    cosmyc::VanityCheckpoint checkpoint;
+
+    if (!checkpoint.Load(STD_STRING(vanityCheckpointPath()))) {
+        ui->label_VanitySearchStatus->setText("No saved search to resume");
+        return;
+    }
+
+    vanitySearch.SetAutoCheckpoint(STD_STRING(vanityCheckpointPath()), 10);
+    if (!vanitySearch.Resume(checkpoint)) {
+        ui->label_VanitySearchStatus->setText("Invalid checkpoint or search is already running");
+        return;
+    }
+
+    vanitySearchTimer.start(500);
+    updateVanitySearch();
+}
+
+void BitcoinTests::updateVanitySearch()
+{
+    cosmyc::VanityReport report = vanitySearch.Report();
+
+    size_t found = 0;
+    for (const auto &pattern : report.patterns) {
+        if (pattern.hits > 0)
+            found++;
+    }
+
+    ui->label_VanitySearchStatus->setText(
+                QString("%1: %2 keys, %3 addresses in %4 s, %5 addresses/s on %6 threads, %7 of %8 patterns found\n"
+                        "Match probability so far %9%, 50% in %10, 90% in %11")
+                .arg(report.running ? "Searching" : "Stopped")
+                .arg(report.keysTested)
+                .arg(report.addresses)
+                .arg(report.elapsed, 0, 'f', 1)
+                .arg(report.addressesPerSecond, 0, 'f', 0)
+                .arg(report.threads)
+                .arg(found)
+                .arg(report.patterns.size())
+                .arg(report.probability * 100, 0, 'f', 1)
+                .arg(formatEta(report.eta50))
+                .arg(formatEta(report.eta90)));
+
+    if (!report.matches.empty()) {
+        ui->lineEdit_VanitySearchAddress->setText(QT_STRING(report.matches.front().address));
+        ui->lineEdit_VanitySearchPrivKey->setText(QT_STRING(report.matches.front().privateKey));
+        ui->label_VanitySearchPrivKey->setText(report.matches.front().splitKey != cosmyc::skNone ? "Partial key:" : "Private key:");
+    }
+
+    if (!report.running)
+        vanitySearchTimer.stop();
+}
+
 void BitcoinTests::updateAddressTest(bool GenerateNewKeys)
 {
     /// Address tests
@@ -535,15 +665,13 @@ void BitcoinTests::calcAddressTestFast()
     QString     PublicKeyStr = ui->le_Addr_PublicKey->text().trimmed();
     QByteArray  PublicKey = QByteArray::fromHex(PublicKeyStr.toUtf8().data());
 
-    QByteArray  Blob1 = helper::CalcHashN(PublicKey, {CDigest::dtSHA256, CDigest::dtRIPEMD160});
-    Blob1.insert(0, (char)0x00);
-
-    QByteArray  Blob2 = helper::CalcHashN(Blob1, {CDigest::dtSHA256, CDigest::dtSHA256});
+    // Version byte, then the hash160 written in place behind it
+    QByteArray  Blob1(1 + HASH160_OUTPUT_SIZE, (char)0x00);
+    Hash160((const unsigned char *)PublicKey.constData(), PublicKey.size(), (unsigned char *)Blob1.data() + 1);
 
-    for (int k = 0; k < 4; k++)
-    {
-        Blob1 += Blob2.at(k);
-    }
+    unsigned char Checksum[SHA256D_CHECKSUM_SIZE];
+    SHA256d_Checksum((const unsigned char *)Blob1.constData(), Blob1.size(), Checksum);
+    Blob1.append((const char *)Checksum, SHA256D_CHECKSUM_SIZE);
 
     ui->lbl_Addr_FastResData->setText(helper::encodeBase58(Blob1));
 };
@@ -572,6 +700,11 @@ void BitcoinTests::updateWIF()
     ui->lineEdit_AfterBase58->setText(helper::encodeBase58(beforeBase58));
 }
 
+void BitcoinTests::slotVanitySearchTimer()
+{
+    updateVanitySearch();
+}
+
 void BitcoinTests::slotHashTypeChange(QString)
 {
     bool enabled = (ui->comboBox_HashType->currentText() == "Base58") ? false : true;
@@ -695,11 +828,24 @@ void BitcoinTests::runCommand(QString command)
         ui->lineEdit_VanityPublicKeyFromModdifiedBasePoing_M->setText(helper::getPublicFromModfiedBasePoint(ui->lineEdit_VanityPublicECDSAKey1_M->text(), ui->lineEdit_VanityPrivECDSAKey_M2->text()).toUpper());
         ui->lineEdit_CorrAddress2->setText(helper::getWIFFromPublicKey(ui->lineEdit_VanityPublicKeyFromModdifiedBasePoing_M->text()));
     }else if (command == "pushButton_CalculatePattern") {
-        auto patterComplexity = cosmyc::Vanity::PatternComplexity(ui->lineEdit_Pattern->text());
-        ui->label_PatternComplexityRes->setText(helper::getStringFromDouble(patterComplexity));
+        // Same pattern list as the search: the odds of a match of any of them
+        const QStringList patterns = cosmyc::Vanity::SplitPatterns(ui->lineEdit_Pattern->text());
+        QStringList invalid;
+        for (const QString &pattern : patterns) {
+            if (!cosmyc::VanityPattern::IsValid(STD_STRING(pattern)))
+                invalid << pattern;
+        }
 
-        ui->label_PatternLavishnessRes->setText(helper::getStringFromDouble(cosmyc::Vanity::PatternLavishness(
-                                                    ui->lineEdit_Bountry->text().toULongLong(), patterComplexity)));
+        if (patterns.isEmpty() || !invalid.isEmpty()) {
+            ui->label_PatternComplexityRes->setText(patterns.isEmpty() ? "No pattern" : "Invalid pattern: " + invalid.join(", "));
+            ui->label_PatternLavishnessRes->setText("");
+        } else {
+            auto patterComplexity = cosmyc::Vanity::PatternComplexity(ui->lineEdit_Pattern->text());
+            ui->label_PatternComplexityRes->setText(helper::getStringFromDouble(patterComplexity));
+
+            ui->label_PatternLavishnessRes->setText(helper::getStringFromDouble(cosmyc::Vanity::PatternLavishness(
+                                                        ui->lineEdit_Bountry->text().toULongLong(), patterComplexity)));
+        }
     }
     else if (command == "pb_Addr_NewKeyPair")
     {
@@ -708,6 +854,15 @@ void BitcoinTests::runCommand(QString command)
     else if (command == "pb_Addr_CalcFast")
     {
         calcAddressTestFast();
+    } else if (command == "pushButton_VanitySearchStart") {
+        startVanitySearch();
+    } else if (command == "pushButton_VanitySearchStop") {
+        vanitySearch.Stop();
+        updateVanitySearch();
+    } else if (command == "pushButton_VanitySearchResume") {
+        resumeVanitySearch();
+    } else if (command == "pushButton_VanitySearchStats") {
+        QApplication::clipboard()->setText(QT_STRING(cosmyc::VanitySearch::ReportJson(vanitySearch.Report())));
     } else {
         qDebug() << "Core::buttonsClicked(); Unknown sender()->objectName() == " << sender()->objectName();
     }
@@ -5,7 +5,9 @@
 #include <QDebug>
 #include <QCryptographicHash>
 #include <QMessageBox>
+#include <QTimer>
 #include "helper.h"
+#include "vanitysearch.h"
 
 #define ADDRESS_TEST_ECDSA_PRIVATE_KEY  "18E14A7B6A307F426A94F8114701E7C8E774E7F9A47E2C2035DB29A206321725"
 #define ADDRESS_TEST_ECDSA_PUBLIC_KEY   "0450863AD64A87AE8A2FE83C1AF1A8403CB53F53E486D8511DAD8A04887E5B23522CD470243453A299FA9E77237716103ABC11A1DF38855ED6F2EE187E9C582BA6"
@@ -27,6 +29,9 @@ public:
 private:
     Ui::BitcoinTests *ui;
 
+    cosmyc::VanitySearch    vanitySearch;
+    QTimer                  vanitySearchTimer;
+
     void updatePrivECDSAKey();
     void updateWIF();
     void runCommand(QString);
@@ -41,9 +46,14 @@ private:
     void randAllVanityTest();
     void updateAllVanityTest();
 
+    void startVanitySearch();
+    void resumeVanitySearch();
+    void updateVanitySearch();
+
 private slots:
     void buttonsClicked();
     void slotHashTypeChange(QString);
+    void slotVanitySearchTimer();
 
 };
 
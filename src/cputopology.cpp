@@ -0,0 +1,247 @@
+#include "cputopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdlib.h>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+/// Node of the calling thread, set by CpuTopology::Pin()
+thread_local int currentNode = -1;
+
+const char *POLICY_NAMES[] = { "none", "compact", "spread", "physical" };
+
+bool readLine(const std::string &path, std::string &line)
+{
+    std::ifstream file(path.c_str());
+    return bool(std::getline(file, line));
+}
+
+bool readNumber(const std::string &path, unsigned &value)
+{
+    std::string line;
+    if (!readLine(path, line) || line.empty())
+        return false;
+    value = unsigned(strtoul(line.c_str(), nullptr, 10));
+    return true;
+}
+
+/// Kernel CPU list, e.g. "0-3,8,10-11"
+std::vector<unsigned> parseCpuList(const std::string &list)
+{
+    std::vector<unsigned> result;
+    size_t position = 0;
+
+    while (position < list.size()) {
+        size_t end = list.find(',', position);
+        if (end == std::string::npos)
+            end = list.size();
+
+        const std::string   item = list.substr(position, end - position);
+        const size_t        dash = item.find('-');
+        if (!item.empty()) {
+            const unsigned first = unsigned(strtoul(item.c_str(), nullptr, 10));
+            const unsigned last = dash == std::string::npos ? first : unsigned(strtoul(item.c_str() + dash + 1, nullptr, 10));
+            for (unsigned cpu = first; cpu <= last; cpu++)
+                result.push_back(cpu);
+        }
+        position = end + 1;
+    }
+    return result;
+}
+
+} // namespace
+
+
+cosmyc::CpuTopology::CpuTopology()
+    : FNodes(1)
+    , FPhysicalCores(0)
+    , FCanPin(false)
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+
+    std::string online;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0
+            && readLine("/sys/devices/system/cpu/online", online)) {
+        // Machines without NUMA have no node directory, all is node 0
+        std::map<unsigned, unsigned>    nodeOf;
+        std::string                     nodes;
+        if (readLine("/sys/devices/system/node/online", nodes)) {
+            for (unsigned node : parseCpuList(nodes)) {
+                std::string cpus;
+                if (readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpus)) {
+                    for (unsigned cpu : parseCpuList(cpus))
+                        nodeOf[cpu] = node;
+                }
+            }
+        }
+
+        // Only the CPUs this process may run on, e.g. inside a cpuset
+        for (unsigned cpu : parseCpuList(online)) {
+            if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+                continue;
+
+            const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+
+            CpuInfo info;
+            info.cpu = cpu;
+            info.node = nodeOf.count(cpu) ? nodeOf[cpu] : 0;
+            info.sibling = 0;
+            if (!readNumber(topology + "core_id", info.core))
+                info.core = cpu;
+            if (!readNumber(topology + "physical_package_id", info.package))
+                info.package = 0;
+            FCpus.push_back(info);
+        }
+        FCanPin = !FCpus.empty();
+    }
+#endif
+
+    if (FCpus.empty()) {
+        const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < count; cpu++) {
+            CpuInfo info;
+            info.cpu = cpu;
+            info.core = cpu;
+            info.package = 0;
+            info.node = 0;
+            info.sibling = 0;
+            FCpus.push_back(info);
+        }
+    }
+
+    // Hyperthreads of one core share package and core id
+    std::map<std::pair<unsigned, unsigned>, unsigned>   siblings;
+    std::set<unsigned>                                  nodes;
+    for (auto &info : FCpus) {
+        info.sibling = siblings[std::make_pair(info.package, info.core)]++;
+        nodes.insert(info.node);
+    }
+    FPhysicalCores = siblings.size();
+    FNodes = nodes.size();
+}
+
+const cosmyc::CpuTopology &cosmyc::CpuTopology::Get()
+{
+    static const CpuTopology topology;
+    return topology;
+}
+
+const std::vector<cosmyc::CpuInfo> &cosmyc::CpuTopology::Cpus() const
+{
+    return FCpus;
+}
+
+unsigned cosmyc::CpuTopology::Nodes() const
+{
+    return FNodes;
+}
+
+unsigned cosmyc::CpuTopology::PhysicalCores() const
+{
+    return FPhysicalCores;
+}
+
+bool cosmyc::CpuTopology::CanPin() const
+{
+    return FCanPin;
+}
+
+unsigned cosmyc::CpuTopology::DefaultThreads(PLACEMENT_POLICY policy) const
+{
+    return policy == ppPhysical ? FPhysicalCores : unsigned(FCpus.size());
+}
+
+std::vector<unsigned> cosmyc::CpuTopology::Placement(PLACEMENT_POLICY policy, unsigned threads) const
+{
+    std::vector<unsigned> placement;
+    if (policy == ppNone || !FCanPin || threads == 0)
+        return placement;
+
+    typedef std::tuple<unsigned, unsigned, unsigned, unsigned> Key;
+    std::vector<std::pair<Key, unsigned> > order;
+
+    if (policy == ppCompact) {
+        // Node by node, the hyperthreads of a core next to each other
+        for (unsigned k = 0; k < FCpus.size(); k++) {
+            const CpuInfo &info = FCpus[k];
+            order.push_back(std::make_pair(Key(info.node, info.package, info.core, info.sibling), k));
+        }
+    } else {
+        // Number the cores of every node per hyperthread level, then deal
+        // them out level by level and node by node, so the second
+        // hyperthread of a core is only used once every core has one
+        std::vector<std::pair<Key, unsigned> > byNode;
+        for (unsigned k = 0; k < FCpus.size(); k++) {
+            const CpuInfo &info = FCpus[k];
+            if (policy == ppPhysical && info.sibling != 0)
+                continue;
+            byNode.push_back(std::make_pair(Key(info.sibling, info.node, info.package, info.core), k));
+        }
+        std::sort(byNode.begin(), byNode.end());
+
+        std::map<std::pair<unsigned, unsigned>, unsigned> rank;
+        for (const auto &entry : byNode) {
+            const CpuInfo &info = FCpus[entry.second];
+            const unsigned position = rank[std::make_pair(info.sibling, info.node)]++;
+            order.push_back(std::make_pair(Key(info.sibling, position, info.node, 0), entry.second));
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    for (unsigned k = 0; k < threads; k++)
+        placement.push_back(order[k % order.size()].second);
+    return placement;
+}
+
+bool cosmyc::CpuTopology::Pin(unsigned index) const
+{
+    if (!FCanPin || index >= FCpus.size())
+        return false;
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(FCpus[index].cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        return false;
+
+    currentNode = int(FCpus[index].node);
+    return true;
+#else
+    return false;
+#endif
+}
+
+int cosmyc::CpuTopology::CurrentNode()
+{
+    return currentNode;
+}
+
+const char *cosmyc::CpuTopology::PolicyName(PLACEMENT_POLICY policy)
+{
+    return unsigned(policy) < sizeof(POLICY_NAMES) / sizeof(POLICY_NAMES[0]) ? POLICY_NAMES[policy] : "?";
+}
+
+bool cosmyc::CpuTopology::ParsePolicy(const std::string &name, PLACEMENT_POLICY &policy)
+{
+    for (unsigned k = 0; k < sizeof(POLICY_NAMES) / sizeof(POLICY_NAMES[0]); k++) {
+        if (name == POLICY_NAMES[k]) {
+            policy = PLACEMENT_POLICY(k);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace cosmyc {
+
+
+/// Where search threads go
+typedef enum _PLACEMENT_POLICY
+{
+    ppNone = 0,         // not pinned, the OS schedules them
+    ppCompact,          // pinned, filling one node and its hyperthreads first
+    ppSpread,           // pinned, physical cores first, round-robin over nodes
+    ppPhysical          // pinned, one thread per physical core at most
+} PLACEMENT_POLICY;
+
+/// One logical CPU this process may run on
+struct CpuInfo
+{
+    unsigned    cpu;        // OS number
+    unsigned    core;       // physical core id, unique within the package
+    unsigned    package;    // socket
+    unsigned    node;       // NUMA node
+    unsigned    sibling;    // 0 for the first hyperthread of its core, 1 ...
+};
+
+/// Processor layout of the machine as far as this process may use it,
+/// read once from sysfs (Linux). Elsewhere, or if sysfs is missing, every
+/// hardware thread counts as its own core on node 0 and nothing is pinned.
+///
+/// Pinning a thread also fixes the node its first-touch allocations land
+/// on, which is why workers pin themselves before they allocate anything.
+class CpuTopology
+{
+public:
+    static const CpuTopology &Get();
+
+    const std::vector<CpuInfo> &Cpus() const;
+    unsigned Nodes() const;
+    unsigned PhysicalCores() const;
+
+    /// False where threads cannot be pinned
+    bool CanPin() const;
+
+    /// Default thread count of policy: one per physical core for
+    /// ppPhysical, one per logical CPU otherwise
+    unsigned DefaultThreads(PLACEMENT_POLICY policy) const;
+
+    /// Index into Cpus() for each of threads, in the order of policy;
+    /// wraps around when there are more threads than CPUs. Empty for
+    /// ppNone or when pinning is not possible.
+    std::vector<unsigned> Placement(PLACEMENT_POLICY policy, unsigned threads) const;
+
+    /// Pins the calling thread to Cpus()[index], returns false if that
+    /// fails. The thread's node is then available through CurrentNode().
+    bool Pin(unsigned index) const;
+
+    /// NUMA node of the calling thread if it is pinned, -1 otherwise
+    static int CurrentNode();
+
+    static const char *PolicyName(PLACEMENT_POLICY policy);
+
+    /// Accepts the names PolicyName() returns
+    static bool ParsePolicy(const std::string &name, PLACEMENT_POLICY &policy);
+
+private:
+    CpuTopology();
+
+    std::vector<CpuInfo>    FCpus;
+    unsigned                FNodes;
+    unsigned                FPhysicalCores;
+    bool                    FCanPin;
+};
+
+
+} // namespace cosmyc
@@ -12,28 +12,65 @@ SOURCES += \
     bitcointests.cpp \
     main.cpp \
     libs/bitcoin/base58.cpp \
+    libs/bitcoin/bech32.cpp \
+    libs/bitcoin/random.cpp \
+    libs/bitcoin/crypto/checksum.cpp \
+    libs/bitcoin/crypto/hash160.cpp \
+    libs/bitcoin/crypto/hmac_sha512.cpp \
+    libs/bitcoin/crypto/kernels.cpp \
     libs/bitcoin/crypto/ripemd160.cpp \
+    libs/bitcoin/crypto/ripemd160_avx2.cpp \
+    libs/bitcoin/crypto/ripemd160_sse2.cpp \
+    libs/bitcoin/crypto/sha1.cpp \
     libs/bitcoin/crypto/sha256.cpp \
+    libs/bitcoin/crypto/sha256_avx2.cpp \
+    libs/bitcoin/crypto/sha256_shani.cpp \
+    libs/bitcoin/crypto/sha256_sse4.cpp \
+    libs/bitcoin/arith_uint256.cpp \
     libs/bitcoin/uint256.cpp \
     vanity.cpp \
+    vanitysearch.cpp \
+    keywalker.cpp \
+    cputopology.cpp \
+    vanitypattern.cpp \
+    vanitypool.cpp \
+    vanityscheduler.cpp \
+    vanitybench.cpp \
     digest.cpp \
     digest_ripemd160.cpp \
     digest_sha256.cpp \
     digest_sha512.cpp \
     libs/bitcoin/crypto/sha512.cpp \
+    libs/bitcoin/crypto/sha512_avx2.cpp \
     libs/bitcoin/uint256.cpp \
     libs/bitcoin/utilstrencodings.cpp
 HEADERS += \
     helper.h \
     bitcointests.h \
     libs/bitcoin/base58.h \
+    libs/bitcoin/bech32.h \
+    libs/bitcoin/random.h \
+    libs/bitcoin/crypto/checksum.h \
+    libs/bitcoin/crypto/hash160.h \
+    libs/bitcoin/crypto/hmac_sha512.h \
+    libs/bitcoin/crypto/kernels.h \
     libs/bitcoin/crypto/ripemd160.h \
+    libs/bitcoin/crypto/ripemd160_inline.h \
+    libs/bitcoin/crypto/sha1.h \
     libs/bitcoin/crypto/sha256.h \
+    libs/bitcoin/crypto/sha256_inline.h \
     libs/bitcoin/uint256.h \
     libs/bitcoin/tinyformat.h \
     libs/bitcoin/utilstrencodings.h \
     libs/bitcoin/arith_uint256.h \
     vanity.h \
+    vanitysearch.h \
+    keywalker.h \
+    cputopology.h \
+    vanitypattern.h \
+    vanitypool.h \
+    vanityscheduler.h \
+    vanitybench.h \
     digest.h \
     digest_ripemd160.h \
     digest_sha256.h \
@@ -47,9 +84,16 @@ FORMS += \
     bitcointests.ui
 
 INCLUDEPATH += $$PWD/libs/bitcoin
+
+# GetStrongRandBytes()
+win32: LIBS += -lbcrypt
 #INCLUDEPATH += c:/boost-1-65-1/include/boost-1_65_1
 #LIBS += "-Lc:/boost-1-65-1/lib" -llibboost_locale-mgw53-mt-1_65_1
 
+### Hash kernels, chosen at runtime by HashKernelsAutoDetect()
+
+DEFINES += USE_ASM
+
 ### from secp256k1/src/basic-config.h
 
 DEFINES -= USE_ASM_X86_64
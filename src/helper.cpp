@@ -5,10 +5,34 @@
 
 #include "digest.h"
 #include "base58.h"
+#include "crypto/checksum.h"
+#include "crypto/hash160.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha256.h"
+#include "keywalker.h"
 #include "secp256k1/src/secp256k1.c"
 
+namespace {
+
+/// Building a context precomputes the ecmult tables, which costs far more
+/// than the multiplication itself. The tables are read-only afterwards,
+/// so a single context serves every call.
+const secp256k1_context *sharedContext()
+{
+    static const secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    return ctx;
+}
+
+/// Base58Check: the payload followed by the first 4 bytes of its double SHA-256
+QString encodeBase58Check(QByteArray payload)
+{
+    unsigned char checksum[SHA256D_CHECKSUM_SIZE];
+    SHA256d_Checksum(reinterpret_cast<const unsigned char *>(payload.constData()), payload.size(), checksum);
+    payload.append(reinterpret_cast<const char *>(checksum), SHA256D_CHECKSUM_SIZE);
+    return helper::encodeBase58(payload);
+}
+
+} // namespace
 
 std::string helper::convertQStringToStdString(const QString &str)
 {
@@ -178,7 +202,7 @@ QString helper::getPublicECDSAKey(
 {
     QByteArray                  ba = QByteArray::fromHex(privKeyQString.toUtf8().data());
     const unsigned char         *seckey = reinterpret_cast<const unsigned char *>(ba.data());
-    const secp256k1_context     *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    const secp256k1_context     *ctx = sharedContext();
     secp256k1_pubkey            pubkey;
     int                         ret = 0;
     size_t                      clen = compressedFlag ? 33 : 65;
@@ -323,19 +347,12 @@ QString helper::getWIFFromPublicKey(const QString &pubkey, QString MainNet)
 {
     QByteArray ba = QByteArray::fromHex(pubkey.toUtf8().data());
     QByteArray ba2 = QByteArray::fromHex(MainNet.toUtf8().data());
-    QByteArray sha256FormHexPubkey = encodeSha256(ba);
-    QByteArray ripemd160OfSha256 = encodeRipemd160(sha256FormHexPubkey);
-    //ripemd160OfSha256.insert(0, QChar(0x00));
     assert(ba2.length() == 1);
-    ripemd160OfSha256.insert(0, ba2[0]);
-    QByteArray sha256FromRipemd160 = encodeSha256(ripemd160OfSha256);
-    QByteArray sha256FromSha256 = encodeSha256(sha256FromRipemd160);
 
-    for (int i = 0; i < 4; i++) {
-        ripemd160OfSha256.append(sha256FromSha256.at(i));
-    }
+    QByteArray payload(1 + HASH160_OUTPUT_SIZE, ba2[0]);
+    Hash160(reinterpret_cast<const unsigned char *>(ba.constData()), ba.size(), reinterpret_cast<unsigned char *>(payload.data() + 1));
 
-    return encodeBase58(ripemd160OfSha256);
+    return encodeBase58Check(payload);
 };
 
 QString helper::getWIFFromPrivateKey(const QString &key, QString prefix)
@@ -344,22 +361,7 @@ QString helper::getWIFFromPrivateKey(const QString &key, QString prefix)
         prefix = "0" + prefix;
     assert(prefix.length() == 2);
 
-    //QString prependVersion = QString("80" + key);
-    QString prependVersion = QString(prefix + key);
-
-    QString stingSHA256HashOf2 = helper::getHexHashSha256FromHexString(prependVersion).toUpper();
-
-    QString stingSHA256HashOf3 = helper::getHexHashSha256FromHexString(stingSHA256HashOf2).toUpper();
-
-    QByteArray first4BitesOf4;
-    for (int i = 0; i < 8; i++) {
-        first4BitesOf4.append(stingSHA256HashOf3.at(i));
-    }
-    QString stringFirst4BitesOf4 = QString(first4BitesOf4);
-
-    QString beforeBase58 = prependVersion + first4BitesOf4;
-
-    return helper::encodeBase58(beforeBase58);
+    return encodeBase58Check(QByteArray::fromHex(QString(prefix + key).toUtf8().data()));
 }
 
 
@@ -382,34 +384,15 @@ QString helper::generateWIF()
 {
     QString phrase = GetRandomString();
     QString privECDSAKey = helper::getHexHashSha256FromString(phrase).toUpper();
-    QString prependVersion = QString("80" + privECDSAKey);
-    QString stingSHA256HashOf2 = helper::getHexHashSha256FromHexString(prependVersion).toUpper();
-    QString stingSHA256HashOf3 = helper::getHexHashSha256FromHexString(stingSHA256HashOf2).toUpper();
-    QByteArray first4BitesOf4;
-    for (int i = 0; i < 8; i++) {
-        first4BitesOf4.append(stingSHA256HashOf3.at(i));
-    }
-    QString stringFirst4BitesOf4 = QString(first4BitesOf4);
-    QString beforeBase58 = prependVersion + first4BitesOf4;
-    return helper::encodeBase58(beforeBase58);
+    return getWIFFromPrivateKey(privECDSAKey, "80");
 }
 
 QString helper::makeWIFCheckSum(QString WIF)
 {
-    QString WIFWork = helper::decodeBase58(QString(WIF));
-    WIFWork.chop(4 * 2);
-
-    QString WIFWorkCopy = WIFWork;
-    WIFWorkCopy = helper::getHexHashSha256FromHexString(WIFWorkCopy).toUpper();
-    WIFWorkCopy = helper::getHexHashSha256FromHexString(WIFWorkCopy).toUpper();
-
-    QByteArray first4BitesOf4;
-    for (int i = 0; i < 4 * 2; ++i)
-        first4BitesOf4.append(WIFWorkCopy.at(i));
-
-    WIFWork += QString(first4BitesOf4);
+    QByteArray WIFWork = QByteArray::fromHex(helper::decodeBase58(QString(WIF)).toUtf8().data());
+    WIFWork.chop(SHA256D_CHECKSUM_SIZE);
 
-    return helper::encodeBase58(WIFWork);
+    return encodeBase58Check(WIFWork);
 }
 
 QString helper::getStringFromDouble(double val)
@@ -443,6 +426,8 @@ void helper::updateContextWithBasePointFromPubkey(secp256k1_context* orig_ctx, c
 //        return;
 //    }
 #ifndef USE_ECMULT_STATIC_PRECOMPUTATION
+    // The context comes with a table for G already
+    secp256k1_ecmult_gen_context_clear(ctx);
     ctx->prec = (secp256k1_ge_storage (*)[64][16])checked_malloc(cb, sizeof(*ctx->prec));
 
     /* get the generator */
@@ -568,26 +553,23 @@ QString helper::getPublicFromModfiedBasePoint(const QString &publicKey, const QS
     int ret = 0;
     size_t clen = 65;
 
-    secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
-
     QByteArray publicKeyBa = QByteArray::fromHex(publicKey.toUtf8().data());
     const unsigned char *publicKeyCuc = reinterpret_cast<const unsigned char *>(publicKeyBa.data());
 
-    secp256k1_pubkey pubkeyOfModifiedPoint;
-    ret = secp256k1_ec_pubkey_parse(ctx, &pubkeyOfModifiedPoint, publicKeyCuc, clen);
-    assert(ret);
-
-    updateContextWithBasePointFromPubkey(ctx, pubkeyOfModifiedPoint);
-
     QByteArray privKeyBa = QByteArray::fromHex(privateKey.toUtf8().data());
     const unsigned char *seckey = reinterpret_cast<const unsigned char *>(privKeyBa.data());
 
-    secp256k1_pubkey pubkeyFromModifiedPoint;
-    ret = secp256k1_ec_pubkey_create(ctx, &pubkeyFromModifiedPoint, seckey);
+    // The walker keeps the comb table of the base point cached,
+    // so repeated calls for the same point do not rebuild it
+    cosmyc::KeyWalker walker(cosmyc::KeyWalker::MIN_BATCH_SIZE);
+    ret = walker.SetBasePoint(publicKeyCuc, publicKeyBa.size());
+    assert(ret);
+
+    ret = walker.Reset(seckey);
     assert(ret);
 
     unsigned char resultFromModifiedPoint[clen];
-    ret = secp256k1_ec_pubkey_serialize(ctx, resultFromModifiedPoint, &clen, &pubkeyFromModifiedPoint, SECP256K1_EC_UNCOMPRESSED);
+    ret = walker.GetPublicKey(resultFromModifiedPoint, &clen, false);
     assert(ret);
 
 //    QByteArray pubKeyFromModifiedPoint = QByteArray(reinterpret_cast<const char*>(resultFromModifiedPoint), clen);
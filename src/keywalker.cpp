@@ -0,0 +1,468 @@
+#include "keywalker.h"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cputopology.h"
+
+// The walker works on secp256k1 group elements directly, so it pulls in
+// the library internals. All of them are static, which keeps this unit
+// independent from the copy helper.cpp compiles through secp256k1.c.
+#include "secp256k1/include/secp256k1.h"
+#include "secp256k1/src/util.h"
+#include "secp256k1/src/num_impl.h"
+#include "secp256k1/src/field_impl.h"
+#include "secp256k1/src/scalar_impl.h"
+#include "secp256k1/src/group_impl.h"
+#include "secp256k1/src/ecmult_impl.h"
+#include "secp256k1/src/ecmult_gen_impl.h"
+#include "secp256k1/src/eckey_impl.h"
+#include "secp256k1/src/hash_impl.h"
+
+namespace {
+
+void errorCallback(const char *str, void *data)
+{
+    (void)data;
+    fprintf(stderr, "[keywalker] internal consistency check failed: %s\n", str);
+    abort();
+}
+
+const secp256k1_callback ERROR_CALLBACK = { errorCallback, NULL };
+
+/// The comb table for G is only read by secp256k1_ecmult_gen, so one
+/// copy is shared by every walker on a NUMA node. The first pinned thread
+/// of a node builds its copy, which puts it in that node's memory; threads
+/// that are not pinned share one more.
+const secp256k1_ecmult_gen_context *genContext()
+{
+    struct Holder
+    {
+        secp256k1_ecmult_gen_context ctx;
+
+        Holder()
+        {
+            secp256k1_ecmult_gen_context_init(&ctx);
+            secp256k1_ecmult_gen_context_build(&ctx, &ERROR_CALLBACK);
+        }
+    };
+
+    static std::mutex                               lock;
+    static std::map<int, std::unique_ptr<Holder> >  holders;   // by node
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    std::unique_ptr<Holder> &holder = holders[cosmyc::CpuTopology::CurrentNode()];
+    if (!holder)
+        holder.reset(new Holder());
+    return &holder->ctx;
+}
+
+/// Cube roots of unity: lambda*(x, y) = (beta*x, y) for every point.
+/// The library only carries them with USE_ENDOMORPHISM.
+const secp256k1_fe BETA = SECP256K1_FE_CONST(
+    0x7ae96a2bUL, 0x657c0710UL, 0x6e64479eUL, 0xac3434e9UL,
+    0x9cf04975UL, 0x12f58995UL, 0xc1396c28UL, 0x719501eeUL
+);
+
+const secp256k1_scalar LAMBDA = SECP256K1_SCALAR_CONST(
+    0x5363ad4cUL, 0xc05c30e0UL, 0xa5261c02UL, 0x8812645aUL,
+    0x122e22eaUL, 0x20816678UL, 0xdf02967cUL, 0x1b23bd72UL
+);
+
+/// secp256k1_ecmult_gen_context for a custom base point
+struct BaseTable
+{
+    secp256k1_ge                    point;
+    secp256k1_ecmult_gen_context    ctx;
+
+    explicit BaseTable(const secp256k1_ge &base);
+    ~BaseTable();
+
+private:
+    BaseTable(const BaseTable &);
+    BaseTable &operator=(const BaseTable &);
+};
+
+/// Same as secp256k1_ecmult_gen_context_build with base instead of G
+BaseTable::BaseTable(const secp256k1_ge &base)
+    : point(base)
+{
+    secp256k1_ecmult_gen_context_init(&ctx);
+    ctx.prec = (secp256k1_ge_storage (*)[64][16])checked_malloc(&ERROR_CALLBACK, sizeof(*ctx.prec));
+
+    // A point with no known discrete log, so the partial sums of the
+    // comb never hit infinity; its contributions cancel out in the end
+    secp256k1_gej nums;
+    {
+        static const unsigned char nums_b32[33] = "The scalar for this x is unknown";
+        secp256k1_fe    nums_x;
+        secp256k1_ge    nums_ge;
+
+        secp256k1_fe_set_b32(&nums_x, nums_b32);
+        secp256k1_ge_set_xo_var(&nums_ge, &nums_x, 0);
+        secp256k1_gej_set_ge(&nums, &nums_ge);
+        secp256k1_gej_add_ge_var(&nums, &nums, &base, NULL);
+    }
+
+    std::vector<secp256k1_gej>  precj(1024);
+    std::vector<secp256k1_ge>   prec(1024);
+    secp256k1_gej               gbase;      // 16^j * base
+    secp256k1_gej               numsbase;   // 2^j * nums
+
+    secp256k1_gej_set_ge(&gbase, &base);
+    numsbase = nums;
+    for (int j = 0; j < 64; j++) {
+        precj[j * 16] = numsbase;
+        for (int i = 1; i < 16; i++)
+            secp256k1_gej_add_var(&precj[j * 16 + i], &precj[j * 16 + i - 1], &gbase, NULL);
+
+        for (int i = 0; i < 4; i++)
+            secp256k1_gej_double_var(&gbase, &gbase, NULL);
+
+        secp256k1_gej_double_var(&numsbase, &numsbase, NULL);
+        if (j == 62) {
+            // The last one is (1 - 2^63) * nums instead
+            secp256k1_gej_neg(&numsbase, &numsbase);
+            secp256k1_gej_add_var(&numsbase, &numsbase, &nums, NULL);
+        }
+    }
+    secp256k1_ge_set_all_gej_var(&prec[0], &precj[0], 1024, &ERROR_CALLBACK);
+
+    for (int j = 0; j < 64; j++) {
+        for (int i = 0; i < 16; i++)
+            secp256k1_ge_to_storage(&(*ctx.prec)[j][i], &prec[j * 16 + i]);
+    }
+
+    // No blinding: secp256k1_ecmult_gen computes (k + 1)*base - base
+    secp256k1_gej_set_ge(&ctx.initial, &base);
+    secp256k1_gej_neg(&ctx.initial, &ctx.initial);
+    secp256k1_scalar_set_int(&ctx.blind, 1);
+}
+
+BaseTable::~BaseTable()
+{
+    secp256k1_ecmult_gen_context_clear(&ctx);
+}
+
+/// Comb table for base, from a small LRU cache shared by all walkers.
+/// Like the table for G there is one copy per NUMA node.
+std::shared_ptr<const BaseTable> baseTable(const secp256k1_ge &base)
+{
+    typedef std::pair<std::string, std::shared_ptr<const BaseTable> > Entry;
+
+    static std::mutex       lock;
+    static std::list<Entry> cache;  // most recently used first
+
+    secp256k1_ge    point = base;
+    unsigned char   serialized[33];
+    size_t          serializedLen = sizeof(serialized);
+    secp256k1_eckey_pubkey_serialize(&point, serialized, &serializedLen, 1);
+    const std::string key = std::to_string(cosmyc::CpuTopology::CurrentNode()) + ":"
+            + std::string(reinterpret_cast<const char *>(serialized), serializedLen);
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = cache.begin(); it != cache.end(); ++it) {
+        if (it->first == key) {
+            cache.splice(cache.begin(), cache, it);
+            return cache.front().second;
+        }
+    }
+
+    // Walkers still using an evicted table keep it alive until they let go
+    if (cache.size() >= cosmyc::KeyWalker::MAX_BASE_POINT_TABLES)
+        cache.pop_back();
+
+    cache.push_front(Entry(key, std::make_shared<BaseTable>(base)));
+    return cache.front().second;
+}
+
+} // namespace
+
+
+struct cosmyc::KeyWalker::State
+{
+    secp256k1_gej       point;      // k*G
+    secp256k1_scalar    key;        // k
+    secp256k1_scalar    one;
+    uint64_t            steps;
+    bool                symmetries;
+
+    bool                hasOffset;
+    secp256k1_ge        offset;     // Q of the split-key walk Q + k*G
+
+    std::shared_ptr<const BaseTable>    base;   // Q of the walk k*Q, or none
+    const secp256k1_ge                  *step;  // G or Q
+
+    // NextBatch() scratch, allocated once
+    size_t                      batchSize;
+    secp256k1_scalar            batchKey;   // private key of entry 0
+    std::vector<secp256k1_gej>  batchPoints;
+    std::vector<secp256k1_fe>   batchZ;
+    std::vector<secp256k1_fe>   batchZInv;
+
+    size_t variants() const
+    {
+        return symmetries && !hasOffset ? SYMMETRY_VARIANTS : 1;
+    }
+};
+
+const size_t cosmyc::KeyWalker::PRIVATE_KEY_SIZE;
+const size_t cosmyc::KeyWalker::MIN_BATCH_SIZE;
+const size_t cosmyc::KeyWalker::DEFAULT_BATCH_SIZE;
+const size_t cosmyc::KeyWalker::MAX_BATCH_SIZE;
+const size_t cosmyc::KeyWalker::MAX_BASE_POINT_TABLES;
+const size_t cosmyc::KeyWalker::SYMMETRY_VARIANTS;
+
+cosmyc::KeyWalker::KeyWalker(size_t batchSize)
+    : FState(new State())
+{
+    secp256k1_gej_set_infinity(&FState->point);
+    secp256k1_scalar_clear(&FState->key);
+    secp256k1_scalar_set_int(&FState->one, 1);
+    FState->steps = 0;
+    FState->symmetries = false;
+    FState->hasOffset = false;
+    FState->step = &secp256k1_ge_const_g;
+
+    FState->batchSize = std::min(std::max(batchSize, MIN_BATCH_SIZE), MAX_BATCH_SIZE);
+    secp256k1_scalar_clear(&FState->batchKey);
+    FState->batchPoints.resize(FState->batchSize);
+    FState->batchZ.resize(FState->batchSize);
+    FState->batchZInv.resize(FState->batchSize);
+}
+
+cosmyc::KeyWalker::~KeyWalker()
+{
+    secp256k1_scalar_clear(&FState->key);
+    secp256k1_scalar_clear(&FState->batchKey);
+    delete FState;
+}
+
+bool cosmyc::KeyWalker::Reset(const unsigned char *seckey)
+{
+    return Reset(seckey, 0);
+}
+
+bool cosmyc::KeyWalker::Reset(const unsigned char *seckey, uint64_t steps)
+{
+    int                 overflow = 0;
+    unsigned char       stepsBytes[32] = { 0 };
+    secp256k1_scalar    offset;
+
+    secp256k1_scalar_set_b32(&FState->key, seckey, &overflow);
+    if (overflow || secp256k1_scalar_is_zero(&FState->key)) {
+        secp256k1_scalar_clear(&FState->key);
+        return false;
+    }
+
+    for (size_t k = 0; k < 8; k++)
+        stepsBytes[31 - k] = (steps >> (8 * k)) & 0xFF;
+    secp256k1_scalar_set_b32(&offset, stepsBytes, NULL);
+    secp256k1_scalar_add(&FState->key, &FState->key, &offset);
+
+    secp256k1_ecmult_gen(FState->base ? &FState->base->ctx : genContext(), &FState->point, &FState->key);
+    if (FState->hasOffset)
+        secp256k1_gej_add_ge_var(&FState->point, &FState->point, &FState->offset, NULL);
+
+    FState->steps = steps;
+    return true;
+}
+
+bool cosmyc::KeyWalker::SetOffset(const unsigned char *pubkey, size_t pubkeyLen)
+{
+    FState->hasOffset = secp256k1_eckey_pubkey_parse(&FState->offset, pubkey, pubkeyLen) != 0;
+    return FState->hasOffset;
+}
+
+void cosmyc::KeyWalker::ClearOffset()
+{
+    FState->hasOffset = false;
+}
+
+bool cosmyc::KeyWalker::HasOffset() const
+{
+    return FState->hasOffset;
+}
+
+bool cosmyc::KeyWalker::SetBasePoint(const unsigned char *pubkey, size_t pubkeyLen)
+{
+    secp256k1_ge point;
+
+    if (!secp256k1_eckey_pubkey_parse(&point, pubkey, pubkeyLen)) {
+        ClearBasePoint();
+        return false;
+    }
+
+    FState->base = baseTable(point);
+    FState->step = &FState->base->point;
+    return true;
+}
+
+void cosmyc::KeyWalker::ClearBasePoint()
+{
+    FState->base.reset();
+    FState->step = &secp256k1_ge_const_g;
+}
+
+bool cosmyc::KeyWalker::HasBasePoint() const
+{
+    return FState->base != nullptr;
+}
+
+void cosmyc::KeyWalker::Step()
+{
+    secp256k1_gej_add_ge_var(&FState->point, &FState->point, FState->step, NULL);
+    secp256k1_scalar_add(&FState->key, &FState->key, &FState->one);
+    FState->steps++;
+}
+
+bool cosmyc::KeyWalker::GetPublicKey(
+            unsigned char   *pubkey,
+            size_t          *pubkeyLen,
+            bool            compressed) const
+{
+    if (secp256k1_gej_is_infinity(&FState->point))
+        return false;
+
+    secp256k1_gej   point = FState->point;
+    secp256k1_ge    affine;
+    secp256k1_ge_set_gej_var(&affine, &point);
+
+    return secp256k1_eckey_pubkey_serialize(&affine, pubkey, pubkeyLen, compressed);
+}
+
+void cosmyc::KeyWalker::GetPrivateKey(unsigned char *seckey) const
+{
+    secp256k1_scalar_get_b32(seckey, &FState->key);
+}
+
+size_t cosmyc::KeyWalker::BatchSize() const
+{
+    return FState->batchSize;
+}
+
+size_t cosmyc::KeyWalker::BatchEntries() const
+{
+    return FState->batchSize * FState->variants();
+}
+
+void cosmyc::KeyWalker::SetSymmetries(bool enabled)
+{
+    FState->symmetries = enabled;
+}
+
+bool cosmyc::KeyWalker::Symmetries() const
+{
+    return FState->symmetries;
+}
+
+size_t cosmyc::KeyWalker::NextBatch(
+            unsigned char   *pubkeys,
+            size_t          stride,
+            bool            compressed)
+{
+    State           &st = *FState;
+    const size_t    n = st.batchSize;
+    const size_t    variants = st.variants();
+    const size_t    outLen = compressed ? 33 : 65;
+    size_t          count = 0;
+
+    st.batchKey = st.key;
+
+    // Walk the batch in Jacobian coordinates and collect the z values
+    for (size_t i = 0; i < n; i++) {
+        st.batchPoints[i] = st.point;
+        if (!st.point.infinity)
+            st.batchZ[count++] = st.point.z;
+        Step();
+    }
+
+    // Montgomery's trick: 1/z for every point from a single inversion
+    secp256k1_fe_inv_all_var(&st.batchZInv[0], &st.batchZ[0], count);
+
+    count = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char *out = pubkeys + i * variants * stride;
+
+        if (st.batchPoints[i].infinity) {
+            for (size_t v = 0; v < variants; v++)
+                memset(out + v * stride, 0, outLen);
+            continue;
+        }
+
+        secp256k1_ge    affine;
+        size_t          len = outLen;
+        secp256k1_ge_set_gej_zinv(&affine, &st.batchPoints[i], &st.batchZInv[count++]);
+        secp256k1_eckey_pubkey_serialize(&affine, out, &len, compressed);
+
+        if (variants == 1)
+            continue;
+
+        // (x, y), (x, -y), (beta*x, y), (beta*x, -y), (beta^2*x, y), (beta^2*x, -y)
+        for (size_t v = 1; v < variants; v++) {
+            unsigned char *variant = out + v * stride;
+
+            if (v % 2 == 0) {
+                secp256k1_fe_mul(&affine.x, &affine.x, &BETA);
+                len = outLen;
+                secp256k1_eckey_pubkey_serialize(&affine, variant, &len, compressed);
+            } else if (compressed) {
+                // Negation only flips the parity of y
+                memcpy(variant, variant - stride, outLen);
+                variant[0] ^= 0x01;
+            } else {
+                secp256k1_ge negated;
+                secp256k1_ge_neg(&negated, &affine);
+                len = outLen;
+                secp256k1_eckey_pubkey_serialize(&negated, variant, &len, compressed);
+            }
+        }
+    }
+
+    return n * variants;
+}
+
+void cosmyc::KeyWalker::GetBatchPrivateKey(size_t index, unsigned char *seckey) const
+{
+    secp256k1_scalar offset;
+    secp256k1_scalar key;
+
+    const size_t variants = FState->variants();
+    const size_t variant = index % variants;
+
+    secp256k1_scalar_set_int(&offset, (unsigned int)(index / variants));
+    secp256k1_scalar_add(&key, &FState->batchKey, &offset);
+
+    for (size_t k = 0; k < variant / 2; k++)
+        secp256k1_scalar_mul(&key, &key, &LAMBDA);
+    if (variant % 2)
+        secp256k1_scalar_negate(&key, &key);
+
+    secp256k1_scalar_get_b32(seckey, &key);
+    secp256k1_scalar_clear(&key);
+}
+
+uint64_t cosmyc::KeyWalker::Steps() const
+{
+    return FState->steps;
+}
+
+void cosmyc::KeyWalker::CompressPublicKey(
+    const   unsigned char   *uncompressed,
+            unsigned char   *compressed)
+{
+    // 0x02 or 0x03 by the parity of y, then x
+    compressed[0] = 0x02 | (uncompressed[64] & 0x01);
+    memcpy(compressed + 1, uncompressed + 1, 32);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cosmyc {
+
+
+/// Sequential keyspace walker.
+/// Reset() pays for one full k*G multiplication, every Step() after
+/// that moves to the next key with a single point addition:
+/// P(k + 1) = P(k) + G, while the private key k is tracked alongside.
+///
+/// Serializing a key needs affine coordinates, i.e. a field inversion.
+/// NextBatch() converts a whole batch of Jacobian points at once with
+/// Montgomery's trick: one inversion plus three multiplications per point.
+/// Larger batches amortize the inversion better but need more memory
+/// (roughly 300 bytes per entry plus the output buffer).
+///
+/// With an offset point Q (SetOffset()) the walk runs over Q + k*G
+/// instead, which is the additive split-key scheme: the walker only ever
+/// knows the partial key k, the owner of Q adds its own key to it.
+///
+/// With curve symmetries enabled (SetSymmetries()) every point P = (x, y)
+/// of a batch yields six keys for the price of one: -P = (x, -y) and the
+/// endomorphism images lambda*P = (beta*x, y), lambda^2*P = (beta^2*x, y)
+/// together with their negations. Their private keys are -k, lambda*k,
+/// -lambda*k, lambda^2*k and -lambda^2*k.
+///
+/// With a base point Q (SetBasePoint()) the walk runs over k*Q and every
+/// step adds Q, the multiplicative split-key scheme. Reset() then needs a
+/// comb table for Q; those are built once and shared through a small
+/// process-wide cache, so jobs for the same Q never rebuild it.
+///
+/// The comb tables (for G and base points) are kept once per NUMA node
+/// of the threads that use them, see CpuTopology::Pin(); so is all
+/// scratch memory, as long as a walker is created on the thread that
+/// uses it.
+class KeyWalker
+{
+public:
+    static const size_t PRIVATE_KEY_SIZE    = 32;
+
+    static const size_t MIN_BATCH_SIZE      = 1;
+    static const size_t DEFAULT_BATCH_SIZE  = 1024;
+    static const size_t MAX_BATCH_SIZE      = 65536;
+
+    /// Comb tables for custom base points kept at once (64 KB each)
+    static const size_t MAX_BASE_POINT_TABLES = 16;
+
+    /// Keys per point with curve symmetries enabled
+    static const size_t SYMMETRY_VARIANTS   = 6;
+
+    explicit KeyWalker(size_t batchSize = DEFAULT_BATCH_SIZE);
+    ~KeyWalker();
+
+    size_t BatchSize() const;
+
+    /// Entries NextBatch() writes: BatchSize() times the keys per point
+    size_t BatchEntries() const;
+
+    /// Makes NextBatch() write the SYMMETRY_VARIANTS keys of every point
+    /// (entry point * SYMMETRY_VARIANTS + variant) instead of one.
+    /// Has no effect with an offset point: -(Q + k*G) has no private key
+    /// of the form q + k'. A base point is fine, -(k*Q) = (-k)*Q.
+    void SetSymmetries(bool enabled);
+    bool Symmetries() const;
+
+    /// Starts the walk at seckey (plus the offset point, if any).
+    /// Returns false if seckey is zero or not below the group order.
+    bool Reset(const unsigned char *seckey);
+
+    /// Continues a walk that started at seckey and went steps keys,
+    /// i.e. starts at seckey + steps with Steps() == steps
+    bool Reset(const unsigned char *seckey, uint64_t steps);
+
+    /// Makes every following Reset() start at pubkey + seckey*G.
+    /// pubkey is a serialized public key (33 or 65 bytes).
+    /// Returns false (and clears the offset) if it does not parse.
+    bool SetOffset(const unsigned char *pubkey, size_t pubkeyLen);
+    void ClearOffset();
+    bool HasOffset() const;
+
+    /// Makes every following Reset() start at seckey*pubkey and Step()
+    /// add pubkey instead of G. Returns false (and goes back to G) if
+    /// pubkey does not parse.
+    bool SetBasePoint(const unsigned char *pubkey, size_t pubkeyLen);
+    void ClearBasePoint();
+    bool HasBasePoint() const;
+
+    /// P += G (or the base point), k += 1
+    void Step();
+
+    /// Serializes the current public key (33 or 65 bytes).
+    /// Returns false if the walk has reached the point at infinity.
+    bool GetPublicKey(
+                unsigned char   *pubkey,
+                size_t          *pubkeyLen,
+                bool            compressed) const;
+
+    void GetPrivateKey(unsigned char *seckey) const;
+
+    /// Serializes the BatchEntries() keys of the BatchSize() points starting
+    /// at the current one into pubkeys, one every stride bytes (stride >= 33
+    /// or 65), and moves the walk past them. Entries of the point at
+    /// infinity are zeroed, valid entries always start with 0x02, 0x03 or
+    /// 0x04. Returns the number of entries written.
+    size_t NextBatch(
+                unsigned char   *pubkeys,
+                size_t          stride,
+                bool            compressed);
+
+    /// Private key (the partial key with an offset or base point) of entry
+    /// index of the last NextBatch() call
+    void GetBatchPrivateKey(size_t index, unsigned char *seckey) const;
+
+    /// Number of Step() calls since the last Reset()
+    uint64_t Steps() const;
+
+    /// Compressed (33-byte) form of a serialized uncompressed public key,
+    /// no curve arithmetic needed
+    static void CompressPublicKey(
+        const   unsigned char   *uncompressed,
+                unsigned char   *compressed);
+
+private:
+    KeyWalker(const KeyWalker &);
+    KeyWalker &operator=(const KeyWalker &);
+
+    struct State;
+    State       *FState;
+};
+
+
+} // namespace cosmyc
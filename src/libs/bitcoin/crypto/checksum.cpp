@@ -0,0 +1,282 @@
+// Copyright (c) 2014-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/checksum.h"
+
+#include "crypto/common.h"
+#include "crypto/kernels.h"
+#include "crypto/sha256.h"
+#include "crypto/sha256_inline.h"
+
+#include <algorithm>
+#include <string.h>
+
+// Internal implementation code.
+namespace
+{
+/** Longest payload that leaves room for 0x80 and the bit length in one block. */
+const size_t ONE_BLOCK = 55;
+
+/** Big-endian message word i of a one-block message of LEN bytes, padding
+ *  included; constant wherever it does not depend on data. */
+template <size_t LEN>
+uint32_t SHA256_ALWAYS_INLINE Word(const unsigned char* data, size_t i)
+{
+    if (i == 15) return LEN * 8;
+    if (4 * i + 4 <= LEN) return ReadBE32(data + 4 * i);
+    if (4 * i > LEN) return 0;
+    // The word where the payload ends and the padding starts
+    uint32_t w = 0;
+    for (int b = 0; b < 4; b++) {
+        const size_t pos = 4 * i + b;
+        const uint32_t byte = pos < LEN ? data[pos] : pos == LEN ? 0x80 : 0;
+        w |= byte << (24 - 8 * b);
+    }
+    return w;
+}
+
+/** First word of the second pass over the 32-byte digest in s, whose padding and length are fixed. */
+uint32_t SHA256_ALWAYS_INLINE SecondPass(const uint32_t* s)
+{
+    uint32_t t[8];
+    sha256_inline::Initialize(t);
+    sha256_inline::Compress(t, s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], 0x80000000ul, 0, 0, 0, 0, 0, 0, 256);
+    return t[0];
+}
+
+template <size_t LEN>
+uint32_t ChecksumFixed(const unsigned char* data)
+{
+    static_assert(LEN <= ONE_BLOCK, "the payload must fit one block");
+    uint32_t s[8];
+    sha256_inline::Initialize(s);
+    sha256_inline::Compress(s, Word<LEN>(data, 0), Word<LEN>(data, 1), Word<LEN>(data, 2), Word<LEN>(data, 3), Word<LEN>(data, 4), Word<LEN>(data, 5), Word<LEN>(data, 6), Word<LEN>(data, 7), Word<LEN>(data, 8), Word<LEN>(data, 9), Word<LEN>(data, 10), Word<LEN>(data, 11), Word<LEN>(data, 12), Word<LEN>(data, 13), Word<LEN>(data, 14), Word<LEN>(data, 15));
+    return SecondPass(s);
+}
+
+/** Lays out a payload of len <= ONE_BLOCK bytes as one padded block. */
+void PadBlock(const unsigned char* data, size_t len, unsigned char* block)
+{
+    memcpy(block, data, len);
+    block[len] = 0x80;
+    memset(block + len + 1, 0, 55 - len);
+    WriteBE64(block + 56, (uint64_t)len << 3);
+}
+
+/** Lays out the digest s of the first pass as the padded block of the second. */
+void PadDigest(const uint32_t* s, unsigned char* block)
+{
+    for (int j = 0; j < 8; j++) WriteBE32(block + 4 * j, s[j]);
+    block[32] = 0x80;
+    memset(block + 33, 0, 23);
+    WriteBE64(block + 56, 256);
+}
+
+/** Payloads longer than a block. */
+void ChecksumLong(const unsigned char* data, size_t len, unsigned char* checksum)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hash);
+    CSHA256().Write(hash, sizeof(hash)).Finalize(hash);
+    memcpy(checksum, hash, SHA256D_CHECKSUM_SIZE);
+}
+
+/** Computes the checksum of one payload of len bytes. */
+typedef void (*ChecksumType)(const unsigned char*, size_t, unsigned char*);
+
+void ChecksumStandard(const unsigned char* data, size_t len, unsigned char* checksum)
+{
+    uint32_t first;
+    switch (len) {
+    case 21: first = ChecksumFixed<21>(data); break;
+    case 33: first = ChecksumFixed<33>(data); break;
+    case 34: first = ChecksumFixed<34>(data); break;
+    case 38: first = ChecksumFixed<38>(data); break;
+    default:
+        if (len > ONE_BLOCK) return ChecksumLong(data, len, checksum);
+        unsigned char block[64];
+        PadBlock(data, len, block);
+        uint32_t s[8];
+        sha256_inline::Initialize(s);
+        sha256_inline::Compress(s,
+            ReadBE32(block), ReadBE32(block + 4), ReadBE32(block + 8), ReadBE32(block + 12),
+            ReadBE32(block + 16), ReadBE32(block + 20), ReadBE32(block + 24), ReadBE32(block + 28),
+            ReadBE32(block + 32), ReadBE32(block + 36), ReadBE32(block + 40), ReadBE32(block + 44),
+            ReadBE32(block + 48), ReadBE32(block + 52), ReadBE32(block + 56), ReadBE32(block + 60));
+        first = SecondPass(s);
+    }
+    WriteBE32(checksum, first);
+}
+
+/** Computes the checksums of n payloads of len bytes each. */
+typedef void (*ChecksumBatchType)(const unsigned char* const*, unsigned char* const*, size_t, size_t);
+
+ChecksumType Checksum = ChecksumStandard;
+const char* ChecksumName = "standard";
+
+void ChecksumSerial(const unsigned char* const* data, unsigned char* const* checksums, size_t n, size_t len)
+{
+    for (size_t i = 0; i < n; i++) {
+        Checksum(data[i], len, checksums[i]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+/** Both passes on the SHA extensions, which want the padded blocks in memory. */
+void ChecksumSHANI(const unsigned char* data, size_t len, unsigned char* checksum)
+{
+    if (len > ONE_BLOCK) return ChecksumLong(data, len, checksum);
+
+    unsigned char block[64];
+    uint32_t s[8], t[8];
+    PadBlock(data, len, block);
+    sha256_inline::Initialize(s);
+    sha256_shani::Transform(s, block, 1);
+
+    PadDigest(s, block);
+    sha256_inline::Initialize(t);
+    sha256_shani::Transform(t, block, 1);
+    WriteBE32(checksum, t[0]);
+}
+
+void ChecksumAVX2(const unsigned char* const* data, unsigned char* const* checksums, size_t n, size_t len)
+{
+    if (len > ONE_BLOCK) return ChecksumSerial(data, checksums, n, len);
+
+    static const uint32_t init[8] = {0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul};
+    unsigned char blocks[8][64];
+    const unsigned char* chunks[8];
+    uint32_t s[64];
+    for (int i = 0; i < 8; i++) chunks[i] = blocks[i];
+
+    while (n >= 8) {
+        for (int i = 0; i < 64; i++) s[i] = init[i / 8];
+        for (int i = 0; i < 8; i++) PadBlock(data[i], len, blocks[i]);
+        sha256_avx2::Transform_8way(s, chunks);
+
+        // The lanes' digests, padded, for the second pass
+        for (int i = 0; i < 8; i++) {
+            uint32_t digest[8];
+            for (int j = 0; j < 8; j++) digest[j] = s[j * 8 + i];
+            PadDigest(digest, blocks[i]);
+        }
+        for (int i = 0; i < 64; i++) s[i] = init[i / 8];
+        sha256_avx2::Transform_8way(s, chunks);
+        for (int i = 0; i < 8; i++) WriteBE32(checksums[i], s[i]);
+
+        data += 8;
+        checksums += 8;
+        n -= 8;
+    }
+    ChecksumSerial(data, checksums, n, len);
+}
+
+bool HasSHANI() { return HasCpuFeature(CpuFeature::SHANI) && HasCpuFeature(CpuFeature::SSE41); }
+bool HasAVX2() { return HasCpuFeature(CpuFeature::AVX2); }
+#endif
+#endif
+
+bool SelfTest(ChecksumType checksum) {
+    // Payloads of fixed, one-block and longer lengths
+    static const size_t lengths[] = {21, 33, 34, 38, 55, 5, 80};
+    static const unsigned char out[][SHA256D_CHECKSUM_SIZE] = {
+        {0xbd, 0x2b, 0x88, 0x65}, {0xa7, 0xb0, 0x3e, 0xd4}, {0xf2, 0x46, 0x54, 0x91}, {0x58, 0x1f, 0xde, 0x7c}, {0x42, 0x43, 0x3e, 0xbd}, {0x93, 0xd0, 0xea, 0xe5}, {0x65, 0x2a, 0x7a, 0x41}
+    };
+    unsigned char data[80];
+    unsigned char result[SHA256D_CHECKSUM_SIZE];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = i * 7 + 1;
+    for (size_t k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++) {
+        checksum(data, lengths[k], result);
+        if (memcmp(result, out[k], sizeof(result))) return false;
+    }
+    return true;
+}
+
+bool SelfTestBatch(ChecksumBatchType batch) {
+    // Nine 34-byte payloads, so that a wide kernel also hands one to its fallback
+    static const unsigned char out[SHA256D_CHECKSUM_SIZE] = {0xf2, 0x46, 0x54, 0x91};
+    unsigned char data[9][34];
+    unsigned char results[9][SHA256D_CHECKSUM_SIZE];
+    const unsigned char* inputs[9];
+    unsigned char* outputs[9];
+    for (int k = 0; k < 9; k++) {
+        for (size_t i = 0; i < sizeof(data[k]); i++) data[k][i] = i * 7 + 1;
+        inputs[k] = data[k];
+        outputs[k] = results[k];
+    }
+    batch(inputs, outputs, 9, 34);
+    for (int k = 0; k < 9; k++) {
+        if (memcmp(results[k], out, sizeof(out))) return false;
+    }
+    return true;
+}
+
+const KernelChoice<ChecksumType> KERNELS[] = {
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+    {"shani", ChecksumSHANI, HasSHANI},
+#endif
+#endif
+    {"standard", ChecksumStandard, nullptr},
+};
+
+const KernelChoice<ChecksumBatchType> BATCHES[] = {
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+    {"avx2", ChecksumAVX2, HasAVX2},
+#endif
+#endif
+    {"serial", ChecksumSerial, nullptr},
+};
+
+ChecksumBatchType Batch = ChecksumSerial;
+const char* BatchName = "serial";
+
+} // namespace
+
+std::vector<std::string> ChecksumKernels()
+{
+    return KernelNames(KERNELS);
+}
+
+bool ChecksumSelectKernel(const std::string& name)
+{
+    return SelectKernel(KERNELS, name, SelfTest, Checksum, ChecksumName);
+}
+
+std::string ChecksumKernel()
+{
+    return ChecksumName;
+}
+
+std::vector<std::string> ChecksumBatchKernels()
+{
+    std::vector<std::string> names = KernelNames(BATCHES);
+    // A single SHA-NI stream outruns eight AVX2 lanes
+    if (HasCpuFeature(CpuFeature::SHANI) && HasCpuFeature(CpuFeature::SSE41)) {
+        std::stable_partition(names.begin(), names.end(), [](const std::string& name) { return name == "serial"; });
+    }
+    return names;
+}
+
+bool ChecksumBatchSelectKernel(const std::string& name)
+{
+    return SelectKernel(BATCHES, name, SelfTestBatch, Batch, BatchName);
+}
+
+std::string ChecksumBatchKernel()
+{
+    return BatchName;
+}
+
+void SHA256d_Checksum(const unsigned char* data, size_t len, unsigned char checksum[SHA256D_CHECKSUM_SIZE])
+{
+    Checksum(data, len, checksum);
+}
+
+void SHA256d_ChecksumBatch(const unsigned char* const data[], unsigned char* const checksums[], size_t n, size_t len)
+{
+    Batch(data, checksums, n, len);
+}
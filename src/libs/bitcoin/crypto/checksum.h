@@ -0,0 +1,25 @@
+// Copyright (c) 2014-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_CHECKSUM_H
+#define BITCOIN_CRYPTO_CHECKSUM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static const size_t SHA256D_CHECKSUM_SIZE = 4;
+
+/** The Base58Check checksum: the first 4 bytes of SHA256(SHA256(data)).
+ *  Payloads of up to 55 bytes take a single block per pass, and addresses
+ *  (21 bytes) and WIF keys (33 and 34 bytes) have their padding folded in
+ *  at compile time.
+ */
+void SHA256d_Checksum(const unsigned char* data, size_t len, unsigned char checksum[SHA256D_CHECKSUM_SIZE]);
+
+/** SHA256d_Checksum() of n payloads of len bytes each, eight at a time
+ *  where the CPU has the lanes for it.
+ */
+void SHA256d_ChecksumBatch(const unsigned char* const data[], unsigned char* const checksums[], size_t n, size_t len);
+
+#endif // BITCOIN_CRYPTO_CHECKSUM_H
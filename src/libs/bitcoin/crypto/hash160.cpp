@@ -0,0 +1,218 @@
+// Copyright (c) 2014 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/hash160.h"
+
+#include "crypto/common.h"
+#include "crypto/kernels.h"
+#include "crypto/ripemd160.h"
+#include "crypto/ripemd160_inline.h"
+#include "crypto/sha256.h"
+#include "crypto/sha256_inline.h"
+
+#include <algorithm>
+#include <string.h>
+
+// Internal implementation code.
+namespace
+{
+/** RIPEMD-160 of the 32-byte SHA-256 digest held in s, written to out. The
+ *  digest bytes are the big-endian state words, which RIPEMD-160 reads back
+ *  little-endian; the padding and bit length (256) are fixed. */
+void inline Finish(const uint32_t* s, unsigned char* out)
+{
+    uint32_t r[5];
+    ripemd160_inline::Initialize(r);
+    ripemd160_inline::Compress(r,
+        bswap_32(s[0]), bswap_32(s[1]), bswap_32(s[2]), bswap_32(s[3]),
+        bswap_32(s[4]), bswap_32(s[5]), bswap_32(s[6]), bswap_32(s[7]),
+        0x80, 0, 0, 0, 0, 0, 256, 0);
+    WriteLE32(out, r[0]);
+    WriteLE32(out + 4, r[1]);
+    WriteLE32(out + 8, r[2]);
+    WriteLE32(out + 12, r[3]);
+    WriteLE32(out + 16, r[4]);
+}
+
+/** Hashes a 33- or 65-byte public key. */
+typedef void (*Hash160Type)(const unsigned char*, size_t, unsigned char*);
+
+void Hash160Standard(const unsigned char* pubkey, size_t len, unsigned char* hash)
+{
+    uint32_t s[8];
+    sha256_inline::Initialize(s);
+    if (len == 33) {
+        // 33 bytes, then 0x80 and the bit length 264 in one block
+        sha256_inline::Compress(s,
+            ReadBE32(pubkey), ReadBE32(pubkey + 4), ReadBE32(pubkey + 8), ReadBE32(pubkey + 12),
+            ReadBE32(pubkey + 16), ReadBE32(pubkey + 20), ReadBE32(pubkey + 24), ReadBE32(pubkey + 28),
+            (uint32_t)pubkey[32] << 24 | 0x800000, 0, 0, 0, 0, 0, 0, 264);
+    } else {
+        // 64 bytes, then the last byte, 0x80 and the bit length 520 in a second block
+        sha256_inline::Compress(s,
+            ReadBE32(pubkey), ReadBE32(pubkey + 4), ReadBE32(pubkey + 8), ReadBE32(pubkey + 12),
+            ReadBE32(pubkey + 16), ReadBE32(pubkey + 20), ReadBE32(pubkey + 24), ReadBE32(pubkey + 28),
+            ReadBE32(pubkey + 32), ReadBE32(pubkey + 36), ReadBE32(pubkey + 40), ReadBE32(pubkey + 44),
+            ReadBE32(pubkey + 48), ReadBE32(pubkey + 52), ReadBE32(pubkey + 56), ReadBE32(pubkey + 60));
+        sha256_inline::Compress(s,
+            (uint32_t)pubkey[64] << 24 | 0x800000, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 520);
+    }
+    Finish(s, hash);
+}
+
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+/** The SHA-256 half on the SHA extensions, which want the padded block in memory. */
+void Hash160SHANI(const unsigned char* pubkey, size_t len, unsigned char* hash)
+{
+    unsigned char block[64] = {0};
+    uint32_t s[8];
+    sha256_inline::Initialize(s);
+    if (len == 33) {
+        memcpy(block, pubkey, 33);
+        block[33] = 0x80;
+        WriteBE64(block + 56, 264);
+    } else {
+        sha256_shani::Transform(s, pubkey, 1);
+        block[0] = pubkey[64];
+        block[1] = 0x80;
+        WriteBE64(block + 56, 520);
+    }
+    sha256_shani::Transform(s, block, 1);
+    Finish(s, hash);
+}
+
+bool HasSHANI() { return HasCpuFeature(CpuFeature::SHANI) && HasCpuFeature(CpuFeature::SSE41); }
+#endif
+#endif
+
+bool SelfTest(Hash160Type hash160) {
+    // The generator point, compressed and uncompressed
+    static const unsigned char pubkey[65] = {
+        0x04,
+        0x79, 0xbe, 0x66, 0x7e, 0xf9, 0xdc, 0xbb, 0xac, 0x55, 0xa0, 0x62, 0x95, 0xce, 0x87, 0x0b, 0x07,
+        0x02, 0x9b, 0xfc, 0xdb, 0x2d, 0xce, 0x28, 0xd9, 0x59, 0xf2, 0x81, 0x5b, 0x16, 0xf8, 0x17, 0x98,
+        0x48, 0x3a, 0xda, 0x77, 0x26, 0xa3, 0xc4, 0x65, 0x5d, 0xa4, 0xfb, 0xfc, 0x0e, 0x11, 0x08, 0xa8,
+        0xfd, 0x17, 0xb4, 0x48, 0xa6, 0x85, 0x54, 0x19, 0x9c, 0x47, 0xd0, 0x8f, 0xfb, 0x10, 0xd4, 0xb8
+    };
+    static const unsigned char out1[HASH160_OUTPUT_SIZE] = {
+        0x75, 0x1e, 0x76, 0xe8, 0x19, 0x91, 0x96, 0xd4, 0x54, 0x94, 0x1c, 0x45, 0xd1, 0xb3, 0xa3, 0x23,
+        0xf1, 0x43, 0x3b, 0xd6
+    };
+    static const unsigned char out2[HASH160_OUTPUT_SIZE] = {
+        0x91, 0xb2, 0x4b, 0xf9, 0xf5, 0x28, 0x85, 0x32, 0x96, 0x0a, 0xc6, 0x87, 0xab, 0xb0, 0x35, 0x12,
+        0x7b, 0x1d, 0x28, 0xa5
+    };
+    unsigned char compressed[33];
+    unsigned char hash[HASH160_OUTPUT_SIZE];
+    memcpy(compressed, pubkey, 33);
+    compressed[0] = 0x02 | (pubkey[64] & 1);
+    hash160(compressed, 33, hash);
+    if (memcmp(hash, out1, sizeof(hash))) return false;
+    hash160(pubkey, 65, hash);
+    if (memcmp(hash, out2, sizeof(hash))) return false;
+    return true;
+}
+
+const KernelChoice<Hash160Type> KERNELS[] = {
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+    {"shani", Hash160SHANI, HasSHANI},
+#endif
+#endif
+    {"standard", Hash160Standard, nullptr},
+};
+
+Hash160Type Kernel = Hash160Standard;
+const char* KernelName = "standard";
+
+/** Keys per round of Hash160Batch(), sized for its stack buffers. */
+const size_t BATCH_CHUNK = 64;
+
+/** Length of the serialized public key starting with prefix. */
+size_t inline PubkeyLength(unsigned char prefix)
+{
+    return prefix == 0x04 || prefix == 0x06 || prefix == 0x07 ? 65 : 33;
+}
+
+} // namespace
+
+std::vector<std::string> Hash160Kernels()
+{
+    return KernelNames(KERNELS);
+}
+
+bool Hash160SelectKernel(const std::string& name)
+{
+    return SelectKernel(KERNELS, name, SelfTest, Kernel, KernelName);
+}
+
+std::string Hash160Kernel()
+{
+    return KernelName;
+}
+
+void Hash160Compressed(const unsigned char* pubkey, unsigned char hash[HASH160_OUTPUT_SIZE])
+{
+    Kernel(pubkey, 33, hash);
+}
+
+void Hash160Uncompressed(const unsigned char* pubkey, unsigned char hash[HASH160_OUTPUT_SIZE])
+{
+    Kernel(pubkey, 65, hash);
+}
+
+void Hash160(const unsigned char* data, size_t len, unsigned char hash[HASH160_OUTPUT_SIZE])
+{
+    if (len == 33) {
+        Hash160Compressed(data, hash);
+    } else if (len == 65) {
+        Hash160Uncompressed(data, hash);
+    } else {
+        unsigned char digest[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(data, len).Finalize(digest);
+        CRIPEMD160().Write(digest, sizeof(digest)).Finalize(hash);
+    }
+}
+
+void Hash160Batch(const unsigned char* pubkeys, size_t stride, size_t n, unsigned char* out)
+{
+    // Without a RIPEMD-160 lane kernel the fused one-key kernel is faster
+    if (RIPEMD160BatchKernel() == "serial") {
+        for (size_t i = 0; i < n; i++) {
+            const unsigned char* pubkey = pubkeys + i * stride;
+            Kernel(pubkey, PubkeyLength(pubkey[0]), out + i * HASH160_OUTPUT_SIZE);
+        }
+        return;
+    }
+
+    // Each round splits its keys by length, as a SHA-256 batch has one,
+    // and collects their digests in one array for the RIPEMD-160 batch
+    const unsigned char* keys[2][BATCH_CHUNK];
+    unsigned char* keyDigests[2][BATCH_CHUNK];
+    unsigned char digests[BATCH_CHUNK][CSHA256::OUTPUT_SIZE];
+    const unsigned char* digestInputs[BATCH_CHUNK];
+    unsigned char* hashes[BATCH_CHUNK];
+
+    for (size_t first = 0; first < n; first += BATCH_CHUNK) {
+        const size_t count = std::min(BATCH_CHUNK, n - first);
+        size_t compressed = 0, uncompressed = 0;
+        for (size_t i = 0; i < count; i++) {
+            const unsigned char* pubkey = pubkeys + (first + i) * stride;
+            if (PubkeyLength(pubkey[0]) == 33) {
+                keys[0][compressed] = pubkey;
+                keyDigests[0][compressed++] = digests[i];
+            } else {
+                keys[1][uncompressed] = pubkey;
+                keyDigests[1][uncompressed++] = digests[i];
+            }
+            digestInputs[i] = digests[i];
+            hashes[i] = out + (first + i) * HASH160_OUTPUT_SIZE;
+        }
+        SHA256Batch(keys[0], keyDigests[0], compressed, 33);
+        SHA256Batch(keys[1], keyDigests[1], uncompressed, 65);
+        RIPEMD160Batch32(digestInputs, hashes, count);
+    }
+}
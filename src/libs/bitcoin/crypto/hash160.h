@@ -0,0 +1,32 @@
+// Copyright (c) 2014-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_HASH160_H
+#define BITCOIN_CRYPTO_HASH160_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static const size_t HASH160_OUTPUT_SIZE = 20;
+
+/** RIPEMD160(SHA256(pubkey)) of a 33-byte compressed public key. The padding
+ *  is fixed, and the SHA-256 state feeds the RIPEMD-160 block directly. */
+void Hash160Compressed(const unsigned char* pubkey, unsigned char hash[HASH160_OUTPUT_SIZE]);
+
+/** RIPEMD160(SHA256(pubkey)) of a 65-byte uncompressed public key. */
+void Hash160Uncompressed(const unsigned char* pubkey, unsigned char hash[HASH160_OUTPUT_SIZE]);
+
+/** RIPEMD160(SHA256(data)); 33 and 65 bytes take the fused paths above,
+ *  other lengths go through CSHA256 and CRIPEMD160. */
+void Hash160(const unsigned char* data, size_t len, unsigned char hash[HASH160_OUTPUT_SIZE]);
+
+/** Hash160() of n serialized public keys stride bytes apart, each 65 bytes
+ *  long if its prefix is 0x04, 0x06 or 0x07 and 33 bytes otherwise, into
+ *  out (n * HASH160_OUTPUT_SIZE bytes). The keys go through the selected
+ *  SHA-256 and RIPEMD-160 batch kernels, whose lanes hold one key each, in
+ *  rounds of fixed size on the stack: nothing is allocated.
+ */
+void Hash160Batch(const unsigned char* pubkeys, size_t stride, size_t n, unsigned char* out);
+
+#endif // BITCOIN_CRYPTO_HASH160_H
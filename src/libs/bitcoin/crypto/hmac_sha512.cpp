@@ -4,6 +4,7 @@
 
 #include "crypto/hmac_sha512.h"
 
+#include <algorithm>
 #include <string.h>
 
 CHMAC_SHA512::CHMAC_SHA512(const unsigned char* key, size_t keylen)
@@ -32,3 +33,46 @@ void CHMAC_SHA512::Finalize(unsigned char hash[OUTPUT_SIZE])
     inner.Finalize(temp);
     outer.Write(temp, 64).Finalize(hash);
 }
+
+CHMAC_SHA512Pads::CHMAC_SHA512Pads(const unsigned char* key, size_t keylen)
+{
+    unsigned char rkey[128];
+    if (keylen <= 128) {
+        memcpy(rkey, key, keylen);
+        memset(rkey + keylen, 0, 128 - keylen);
+    } else {
+        CSHA512().Write(key, keylen).Finalize(rkey);
+        memset(rkey + 64, 0, 64);
+    }
+
+    for (int n = 0; n < 128; n++)
+        rkey[n] ^= 0x5c;
+    SHA512Midstate(rkey, outer);
+
+    for (int n = 0; n < 128; n++)
+        rkey[n] ^= 0x5c ^ 0x36;
+    SHA512Midstate(rkey, inner);
+}
+
+void HMAC_SHA512Batch(const CHMAC_SHA512Pads* const pads[], const unsigned char* const inputs[], unsigned char* const outputs[], size_t n, size_t len)
+{
+    // Rounds of fixed size, so the inner hashes fit on the stack
+    static const size_t CHUNK = 16;
+    const uint64_t* states[CHUNK];
+    unsigned char temp[CHUNK][CSHA512::OUTPUT_SIZE];
+    const unsigned char* innerHashes[CHUNK];
+    unsigned char* innerOutputs[CHUNK];
+
+    for (size_t first = 0; first < n; first += CHUNK) {
+        const size_t count = std::min(CHUNK, n - first);
+        for (size_t i = 0; i < count; i++) {
+            states[i] = pads[first + i]->inner;
+            innerHashes[i] = innerOutputs[i] = temp[i];
+        }
+        SHA512Batch(states, 128, inputs + first, innerOutputs, count, len);
+        for (size_t i = 0; i < count; i++) {
+            states[i] = pads[first + i]->outer;
+        }
+        SHA512Batch(states, 128, innerHashes, outputs + first, count, CSHA512::OUTPUT_SIZE);
+    }
+}
@@ -29,4 +29,21 @@ public:
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
 };
 
+/** The SHA-512 states of HMAC-SHA-512 under one key after its inner and
+ *  outer pad blocks. Computed once, they serve any number of messages,
+ *  such as the rounds of PBKDF2 over one password. */
+struct CHMAC_SHA512Pads
+{
+    uint64_t inner[8];
+    uint64_t outer[8];
+
+    CHMAC_SHA512Pads(const unsigned char* key, size_t keylen);
+};
+
+/** outputs[i] (64 bytes) = HMAC-SHA-512 of the n messages inputs[i] of len
+ *  bytes each, under the key of pads[i]. Both hashes of every message go
+ *  through SHA512Batch(), four lanes at a time where AVX2 is selected.
+ */
+void HMAC_SHA512Batch(const CHMAC_SHA512Pads* const pads[], const unsigned char* const inputs[], unsigned char* const outputs[], size_t n, size_t len);
+
 #endif // BITCOIN_CRYPTO_HMAC_SHA512_H
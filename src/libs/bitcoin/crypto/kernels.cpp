@@ -0,0 +1,156 @@
+// Copyright (c) 2014-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/kernels.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+/** How the registry reaches one primitive. */
+struct Primitive
+{
+    const char* name;
+    std::vector<std::string> (*kernels)();
+    bool (*select)(const std::string&);
+    std::string (*selected)();
+};
+
+const Primitive PRIMITIVES[] = {
+    {"sha256", SHA256Kernels, SHA256SelectKernel, SHA256Kernel},
+    {"sha256batch", SHA256BatchKernels, SHA256BatchSelectKernel, SHA256BatchKernel},
+    {"hash160", Hash160Kernels, Hash160SelectKernel, Hash160Kernel},
+    {"checksum", ChecksumKernels, ChecksumSelectKernel, ChecksumKernel},
+    {"checksumbatch", ChecksumBatchKernels, ChecksumBatchSelectKernel, ChecksumBatchKernel},
+    {"ripemd160", RIPEMD160Kernels, RIPEMD160SelectKernel, RIPEMD160Kernel},
+    {"ripemd160batch", RIPEMD160BatchKernels, RIPEMD160BatchSelectKernel, RIPEMD160BatchKernel},
+    {"sha512", SHA512Kernels, SHA512SelectKernel, SHA512Kernel},
+    {"sha512batch", SHA512BatchKernels, SHA512BatchSelectKernel, SHA512BatchKernel},
+    {"sha1", SHA1Kernels, SHA1SelectKernel, SHA1Kernel},
+};
+
+const Primitive* FindPrimitive(const std::string& name)
+{
+    for (const auto& primitive : PRIMITIVES) {
+        if (name == primitive.name) return &primitive;
+    }
+    return nullptr;
+}
+
+struct CpuFeatures
+{
+    bool sse41;
+    bool avx2;
+    bool shani;
+
+    CpuFeatures() : sse41(false), avx2(false), shani(false)
+    {
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+        uint32_t eax, ebx, ecx, edx;
+        bool enabled_avx = false;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            sse41 = (ecx >> 19) & 1;
+            const bool have_xsave = (ecx >> 27) & 1;
+            const bool have_avx = (ecx >> 28) & 1;
+            if (have_xsave && have_avx) {
+                // The OS must save the YMM registers on context switches
+                uint32_t a, d;
+                __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+                enabled_avx = (a & 6) == 6;
+            }
+        }
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            avx2 = enabled_avx && ((ebx >> 5) & 1);
+            shani = (ebx >> 29) & 1;
+        }
+#endif
+#endif
+    }
+};
+
+} // namespace
+
+bool HasCpuFeature(CpuFeature feature)
+{
+    static const CpuFeatures features;
+    switch (feature) {
+    case CpuFeature::SSE41: return features.sse41;
+    case CpuFeature::AVX2: return features.avx2;
+    case CpuFeature::SHANI: return features.shani;
+    }
+    return false;
+}
+
+std::vector<HashKernels> ListHashKernels()
+{
+    std::vector<HashKernels> result;
+    for (const auto& primitive : PRIMITIVES) {
+        HashKernels kernels;
+        kernels.primitive = primitive.name;
+        kernels.available = primitive.kernels();
+        kernels.selected = primitive.selected();
+        result.push_back(kernels);
+    }
+    return result;
+}
+
+bool SelectHashKernel(const std::string& primitive, const std::string& kernel)
+{
+    const Primitive* found = FindPrimitive(primitive);
+    return found && found->select(kernel);
+}
+
+std::string HashKernelsAutoDetect(std::string* error)
+{
+    std::string errors;
+    for (const auto& primitive : PRIMITIVES) {
+        // Fall back to the next kernel should one fail its self-test
+        for (const auto& kernel : primitive.kernels()) {
+            if (primitive.select(kernel)) break;
+            errors += std::string(primitive.name) + "=" + kernel + " failed its self-test; ";
+        }
+    }
+
+    const char* overrides = getenv(HASH_KERNELS_ENV);
+    const std::string list = overrides ? overrides : "";
+    size_t position = 0;
+    while (position < list.size()) {
+        size_t end = list.find(',', position);
+        if (end == std::string::npos) end = list.size();
+        const std::string item = list.substr(position, end - position);
+        const size_t equals = item.find('=');
+        if (!item.empty()) {
+            if (equals == std::string::npos) {
+                errors += "malformed " + item + "; ";
+            } else if (!FindPrimitive(item.substr(0, equals))) {
+                errors += "unknown primitive " + item.substr(0, equals) + "; ";
+            } else if (!SelectHashKernel(item.substr(0, equals), item.substr(equals + 1))) {
+                errors += item + " is not available; ";
+            }
+        }
+        position = end + 1;
+    }
+
+    if (error) *error = errors.empty() ? errors : errors.substr(0, errors.size() - 2);
+    return HashKernelsSummary();
+}
+
+std::string HashKernelsSummary()
+{
+    std::string summary;
+    for (const auto& primitive : PRIMITIVES) {
+        if (!summary.empty()) summary += " ";
+        summary += std::string(primitive.name) + "=" + primitive.selected();
+    }
+    return summary;
+}
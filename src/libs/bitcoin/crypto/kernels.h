@@ -0,0 +1,120 @@
+// Copyright (c) 2014-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_KERNELS_H
+#define BITCOIN_CRYPTO_KERNELS_H
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+/** Environment variable overriding the automatic kernel choice, e.g.
+ *  CRYPTOTOOLBOX_KERNELS="sha256=sse4,hash160=standard". */
+static const char* const HASH_KERNELS_ENV = "CRYPTOTOOLBOX_KERNELS";
+
+/** Instruction set extensions a kernel may need. */
+enum class CpuFeature {
+    SSE41,
+    AVX2,  //!< Only if the OS also saves the YMM registers
+    SHANI,
+};
+
+/** Whether this machine supports feature; detected once. */
+bool HasCpuFeature(CpuFeature feature);
+
+/** The kernels of one hash primitive. */
+struct HashKernels
+{
+    std::string primitive;              //!< "sha256", "sha256batch", "hash160", "checksum", "checksumbatch", "ripemd160", "ripemd160batch", "sha512", "sha512batch", "sha1"
+    std::vector<std::string> available; //!< Runnable here, fastest first, "standard" or "serial" last
+    std::string selected;
+};
+
+/** Every primitive with its kernels, in a fixed order. */
+std::vector<HashKernels> ListHashKernels();
+
+/** Install kernel for primitive once it passes its known-answer self-test.
+ *  Returns false, leaving the previous kernel in place, if either is unknown,
+ *  the kernel cannot run here or fails its test. Not thread-safe: switch
+ *  kernels only while nothing is being hashed.
+ */
+bool SelectHashKernel(const std::string& primitive, const std::string& kernel);
+
+/** Select the fastest kernel of every primitive, then apply the overrides of
+ *  HASH_KERNELS_ENV. Overrides that cannot be applied are described in error.
+ *  Returns HashKernelsSummary().
+ */
+std::string HashKernelsAutoDetect(std::string* error = nullptr);
+
+/** The selected kernels as "sha256=shani sha256batch=serial ...". */
+std::string HashKernelsSummary();
+
+// Implemented next to each primitive: the kernels runnable here, fastest
+// first; installing one after its self-test; the installed one.
+std::vector<std::string> SHA256Kernels();
+bool SHA256SelectKernel(const std::string& name);
+std::string SHA256Kernel();
+std::vector<std::string> SHA256BatchKernels();
+bool SHA256BatchSelectKernel(const std::string& name);
+std::string SHA256BatchKernel();
+std::vector<std::string> Hash160Kernels();
+bool Hash160SelectKernel(const std::string& name);
+std::string Hash160Kernel();
+std::vector<std::string> ChecksumKernels();
+bool ChecksumSelectKernel(const std::string& name);
+std::string ChecksumKernel();
+std::vector<std::string> ChecksumBatchKernels();
+bool ChecksumBatchSelectKernel(const std::string& name);
+std::string ChecksumBatchKernel();
+std::vector<std::string> RIPEMD160Kernels();
+bool RIPEMD160SelectKernel(const std::string& name);
+std::string RIPEMD160Kernel();
+std::vector<std::string> RIPEMD160BatchKernels();
+bool RIPEMD160BatchSelectKernel(const std::string& name);
+std::string RIPEMD160BatchKernel();
+std::vector<std::string> SHA512Kernels();
+bool SHA512SelectKernel(const std::string& name);
+std::string SHA512Kernel();
+std::vector<std::string> SHA512BatchKernels();
+bool SHA512BatchSelectKernel(const std::string& name);
+std::string SHA512BatchKernel();
+std::vector<std::string> SHA1Kernels();
+bool SHA1SelectKernel(const std::string& name);
+std::string SHA1Kernel();
+
+/** One entry of a primitive's kernel table. */
+template <typename Fn>
+struct KernelChoice
+{
+    const char* name;
+    Fn fn;
+    bool (*supported)(); //!< nullptr if it runs everywhere
+};
+
+/** Names of the runnable entries of table, in table order. */
+template <typename Fn, size_t N>
+std::vector<std::string> KernelNames(const KernelChoice<Fn> (&table)[N])
+{
+    std::vector<std::string> names;
+    for (const auto& choice : table) {
+        if (!choice.supported || choice.supported()) names.push_back(choice.name);
+    }
+    return names;
+}
+
+/** Install the runnable entry name of table into fn and fnName if it passes selfTest. */
+template <typename Fn, size_t N>
+bool SelectKernel(const KernelChoice<Fn> (&table)[N], const std::string& name, bool (*selfTest)(Fn), Fn& fn, const char*& fnName)
+{
+    for (const auto& choice : table) {
+        if (name != choice.name) continue;
+        if ((choice.supported && !choice.supported()) || !selfTest(choice.fn)) return false;
+        fn = choice.fn;
+        fnName = choice.name;
+        return true;
+    }
+    return false;
+}
+
+#endif // BITCOIN_CRYPTO_KERNELS_H
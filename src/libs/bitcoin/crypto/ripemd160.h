@@ -25,4 +25,11 @@ public:
     CRIPEMD160& Reset();
 };
 
+/** Compute the RIPEMD-160 of n independent 32-byte messages, such as SHA-256
+ *  digests: outputs[i] (20 bytes) = RIPEMD160(inputs[i]). Groups of eight or
+ *  four messages go through the AVX2 or SSE2 kernel if selected, the rest
+ *  one by one through the selected transform.
+ */
+void RIPEMD160Batch32(const unsigned char* const inputs[], unsigned char* const outputs[], size_t n);
+
 #endif // BITCOIN_CRYPTO_RIPEMD160_H
@@ -0,0 +1,267 @@
+// Copyright (c) 2014 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "crypto/common.h"
+
+// Only this file is built for AVX2; ripemd160.cpp calls into it after
+// checking the CPU and the OS support it.
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace ripemd160_avx2 {
+namespace {
+
+__m256i inline K(uint32_t x) { return _mm256_set1_epi32(x); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w) { return Add(Add(x, y), Add(z, w)); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+__m256i inline AndNot(__m256i x, __m256i y) { return _mm256_andnot_si256(x, y); }
+__m256i inline Not(__m256i x) { return Xor(x, K(0xFFFFFFFFul)); }
+__m256i inline Rol(__m256i x, int i) { return Or(_mm256_slli_epi32(x, i), _mm256_srli_epi32(x, 32 - i)); }
+
+__m256i inline f1(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline f2(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), AndNot(x, z)); }
+__m256i inline f3(__m256i x, __m256i y, __m256i z) { return Xor(Or(x, Not(y)), z); }
+__m256i inline f4(__m256i x, __m256i y, __m256i z) { return Or(And(x, z), AndNot(z, y)); }
+__m256i inline f5(__m256i x, __m256i y, __m256i z) { return Xor(x, Or(y, Not(z))); }
+
+void inline __attribute__((always_inline)) Round(__m256i& a, __m256i& c, __m256i e, __m256i f, __m256i x, uint32_t k, int r)
+{
+    a = Add(Rol(Add(a, f, x, K(k)), r), e);
+    c = Rol(c, 10);
+}
+
+void inline __attribute__((always_inline)) R11(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f1(b, c, d), x, 0, r); }
+void inline __attribute__((always_inline)) R21(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f2(b, c, d), x, 0x5A827999ul, r); }
+void inline __attribute__((always_inline)) R31(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f3(b, c, d), x, 0x6ED9EBA1ul, r); }
+void inline __attribute__((always_inline)) R41(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f4(b, c, d), x, 0x8F1BBCDCul, r); }
+void inline __attribute__((always_inline)) R51(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f5(b, c, d), x, 0xA953FD4Eul, r); }
+
+void inline __attribute__((always_inline)) R12(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f5(b, c, d), x, 0x50A28BE6ul, r); }
+void inline __attribute__((always_inline)) R22(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f4(b, c, d), x, 0x5C4DD124ul, r); }
+void inline __attribute__((always_inline)) R32(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f3(b, c, d), x, 0x6D703EF3ul, r); }
+void inline __attribute__((always_inline)) R42(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f2(b, c, d), x, 0x7A6D76E9ul, r); }
+void inline __attribute__((always_inline)) R52(__m256i& a, __m256i b, __m256i& c, __m256i d, __m256i e, __m256i x, int r) { Round(a, c, e, f1(b, c, d), x, 0, r); }
+
+/** The little-endian message word at offset of every lane's message. */
+__m256i inline Read8(const unsigned char* const in[8], int offset)
+{
+    return _mm256_set_epi32(
+        ReadLE32(in[7] + offset), ReadLE32(in[6] + offset), ReadLE32(in[5] + offset), ReadLE32(in[4] + offset),
+        ReadLE32(in[3] + offset), ReadLE32(in[2] + offset), ReadLE32(in[1] + offset), ReadLE32(in[0] + offset));
+}
+
+} // namespace
+
+/** RIPEMD-160 of 8 independent 32-byte messages, out[i] (20 bytes) being
+ *  the hash of in[i]. A 32-byte message fills one block whose second half
+ *  is padding, so words 8 to 15 are constants. */
+void Hash32_8way(const unsigned char* const in[8], unsigned char* const out[8])
+{
+    __m256i a1 = K(0x67452301ul), b1 = K(0xEFCDAB89ul), c1 = K(0x98BADCFEul), d1 = K(0x10325476ul), e1 = K(0xC3D2E1F0ul);
+    __m256i a2 = a1, b2 = b1, c2 = c1, d2 = d1, e2 = e1;
+    const __m256i w0 = Read8(in, 0), w1 = Read8(in, 4), w2 = Read8(in, 8), w3 = Read8(in, 12);
+    const __m256i w4 = Read8(in, 16), w5 = Read8(in, 20), w6 = Read8(in, 24), w7 = Read8(in, 28);
+    const __m256i w8 = K(0x80), w9 = K(0), w10 = K(0), w11 = K(0);
+    const __m256i w12 = K(0), w13 = K(0), w14 = K(32 << 3), w15 = K(0);
+
+    R11(a1, b1, c1, d1, e1, w0, 11);
+    R12(a2, b2, c2, d2, e2, w5, 8);
+    R11(e1, a1, b1, c1, d1, w1, 14);
+    R12(e2, a2, b2, c2, d2, w14, 9);
+    R11(d1, e1, a1, b1, c1, w2, 15);
+    R12(d2, e2, a2, b2, c2, w7, 9);
+    R11(c1, d1, e1, a1, b1, w3, 12);
+    R12(c2, d2, e2, a2, b2, w0, 11);
+    R11(b1, c1, d1, e1, a1, w4, 5);
+    R12(b2, c2, d2, e2, a2, w9, 13);
+    R11(a1, b1, c1, d1, e1, w5, 8);
+    R12(a2, b2, c2, d2, e2, w2, 15);
+    R11(e1, a1, b1, c1, d1, w6, 7);
+    R12(e2, a2, b2, c2, d2, w11, 15);
+    R11(d1, e1, a1, b1, c1, w7, 9);
+    R12(d2, e2, a2, b2, c2, w4, 5);
+    R11(c1, d1, e1, a1, b1, w8, 11);
+    R12(c2, d2, e2, a2, b2, w13, 7);
+    R11(b1, c1, d1, e1, a1, w9, 13);
+    R12(b2, c2, d2, e2, a2, w6, 7);
+    R11(a1, b1, c1, d1, e1, w10, 14);
+    R12(a2, b2, c2, d2, e2, w15, 8);
+    R11(e1, a1, b1, c1, d1, w11, 15);
+    R12(e2, a2, b2, c2, d2, w8, 11);
+    R11(d1, e1, a1, b1, c1, w12, 6);
+    R12(d2, e2, a2, b2, c2, w1, 14);
+    R11(c1, d1, e1, a1, b1, w13, 7);
+    R12(c2, d2, e2, a2, b2, w10, 14);
+    R11(b1, c1, d1, e1, a1, w14, 9);
+    R12(b2, c2, d2, e2, a2, w3, 12);
+    R11(a1, b1, c1, d1, e1, w15, 8);
+    R12(a2, b2, c2, d2, e2, w12, 6);
+
+    R21(e1, a1, b1, c1, d1, w7, 7);
+    R22(e2, a2, b2, c2, d2, w6, 9);
+    R21(d1, e1, a1, b1, c1, w4, 6);
+    R22(d2, e2, a2, b2, c2, w11, 13);
+    R21(c1, d1, e1, a1, b1, w13, 8);
+    R22(c2, d2, e2, a2, b2, w3, 15);
+    R21(b1, c1, d1, e1, a1, w1, 13);
+    R22(b2, c2, d2, e2, a2, w7, 7);
+    R21(a1, b1, c1, d1, e1, w10, 11);
+    R22(a2, b2, c2, d2, e2, w0, 12);
+    R21(e1, a1, b1, c1, d1, w6, 9);
+    R22(e2, a2, b2, c2, d2, w13, 8);
+    R21(d1, e1, a1, b1, c1, w15, 7);
+    R22(d2, e2, a2, b2, c2, w5, 9);
+    R21(c1, d1, e1, a1, b1, w3, 15);
+    R22(c2, d2, e2, a2, b2, w10, 11);
+    R21(b1, c1, d1, e1, a1, w12, 7);
+    R22(b2, c2, d2, e2, a2, w14, 7);
+    R21(a1, b1, c1, d1, e1, w0, 12);
+    R22(a2, b2, c2, d2, e2, w15, 7);
+    R21(e1, a1, b1, c1, d1, w9, 15);
+    R22(e2, a2, b2, c2, d2, w8, 12);
+    R21(d1, e1, a1, b1, c1, w5, 9);
+    R22(d2, e2, a2, b2, c2, w12, 7);
+    R21(c1, d1, e1, a1, b1, w2, 11);
+    R22(c2, d2, e2, a2, b2, w4, 6);
+    R21(b1, c1, d1, e1, a1, w14, 7);
+    R22(b2, c2, d2, e2, a2, w9, 15);
+    R21(a1, b1, c1, d1, e1, w11, 13);
+    R22(a2, b2, c2, d2, e2, w1, 13);
+    R21(e1, a1, b1, c1, d1, w8, 12);
+    R22(e2, a2, b2, c2, d2, w2, 11);
+
+    R31(d1, e1, a1, b1, c1, w3, 11);
+    R32(d2, e2, a2, b2, c2, w15, 9);
+    R31(c1, d1, e1, a1, b1, w10, 13);
+    R32(c2, d2, e2, a2, b2, w5, 7);
+    R31(b1, c1, d1, e1, a1, w14, 6);
+    R32(b2, c2, d2, e2, a2, w1, 15);
+    R31(a1, b1, c1, d1, e1, w4, 7);
+    R32(a2, b2, c2, d2, e2, w3, 11);
+    R31(e1, a1, b1, c1, d1, w9, 14);
+    R32(e2, a2, b2, c2, d2, w7, 8);
+    R31(d1, e1, a1, b1, c1, w15, 9);
+    R32(d2, e2, a2, b2, c2, w14, 6);
+    R31(c1, d1, e1, a1, b1, w8, 13);
+    R32(c2, d2, e2, a2, b2, w6, 6);
+    R31(b1, c1, d1, e1, a1, w1, 15);
+    R32(b2, c2, d2, e2, a2, w9, 14);
+    R31(a1, b1, c1, d1, e1, w2, 14);
+    R32(a2, b2, c2, d2, e2, w11, 12);
+    R31(e1, a1, b1, c1, d1, w7, 8);
+    R32(e2, a2, b2, c2, d2, w8, 13);
+    R31(d1, e1, a1, b1, c1, w0, 13);
+    R32(d2, e2, a2, b2, c2, w12, 5);
+    R31(c1, d1, e1, a1, b1, w6, 6);
+    R32(c2, d2, e2, a2, b2, w2, 14);
+    R31(b1, c1, d1, e1, a1, w13, 5);
+    R32(b2, c2, d2, e2, a2, w10, 13);
+    R31(a1, b1, c1, d1, e1, w11, 12);
+    R32(a2, b2, c2, d2, e2, w0, 13);
+    R31(e1, a1, b1, c1, d1, w5, 7);
+    R32(e2, a2, b2, c2, d2, w4, 7);
+    R31(d1, e1, a1, b1, c1, w12, 5);
+    R32(d2, e2, a2, b2, c2, w13, 5);
+
+    R41(c1, d1, e1, a1, b1, w1, 11);
+    R42(c2, d2, e2, a2, b2, w8, 15);
+    R41(b1, c1, d1, e1, a1, w9, 12);
+    R42(b2, c2, d2, e2, a2, w6, 5);
+    R41(a1, b1, c1, d1, e1, w11, 14);
+    R42(a2, b2, c2, d2, e2, w4, 8);
+    R41(e1, a1, b1, c1, d1, w10, 15);
+    R42(e2, a2, b2, c2, d2, w1, 11);
+    R41(d1, e1, a1, b1, c1, w0, 14);
+    R42(d2, e2, a2, b2, c2, w3, 14);
+    R41(c1, d1, e1, a1, b1, w8, 15);
+    R42(c2, d2, e2, a2, b2, w11, 14);
+    R41(b1, c1, d1, e1, a1, w12, 9);
+    R42(b2, c2, d2, e2, a2, w15, 6);
+    R41(a1, b1, c1, d1, e1, w4, 8);
+    R42(a2, b2, c2, d2, e2, w0, 14);
+    R41(e1, a1, b1, c1, d1, w13, 9);
+    R42(e2, a2, b2, c2, d2, w5, 6);
+    R41(d1, e1, a1, b1, c1, w3, 14);
+    R42(d2, e2, a2, b2, c2, w12, 9);
+    R41(c1, d1, e1, a1, b1, w7, 5);
+    R42(c2, d2, e2, a2, b2, w2, 12);
+    R41(b1, c1, d1, e1, a1, w15, 6);
+    R42(b2, c2, d2, e2, a2, w13, 9);
+    R41(a1, b1, c1, d1, e1, w14, 8);
+    R42(a2, b2, c2, d2, e2, w9, 12);
+    R41(e1, a1, b1, c1, d1, w5, 6);
+    R42(e2, a2, b2, c2, d2, w7, 5);
+    R41(d1, e1, a1, b1, c1, w6, 5);
+    R42(d2, e2, a2, b2, c2, w10, 15);
+    R41(c1, d1, e1, a1, b1, w2, 12);
+    R42(c2, d2, e2, a2, b2, w14, 8);
+
+    R51(b1, c1, d1, e1, a1, w4, 9);
+    R52(b2, c2, d2, e2, a2, w12, 8);
+    R51(a1, b1, c1, d1, e1, w0, 15);
+    R52(a2, b2, c2, d2, e2, w15, 5);
+    R51(e1, a1, b1, c1, d1, w5, 5);
+    R52(e2, a2, b2, c2, d2, w10, 12);
+    R51(d1, e1, a1, b1, c1, w9, 11);
+    R52(d2, e2, a2, b2, c2, w4, 9);
+    R51(c1, d1, e1, a1, b1, w7, 6);
+    R52(c2, d2, e2, a2, b2, w1, 12);
+    R51(b1, c1, d1, e1, a1, w12, 8);
+    R52(b2, c2, d2, e2, a2, w5, 5);
+    R51(a1, b1, c1, d1, e1, w2, 13);
+    R52(a2, b2, c2, d2, e2, w8, 14);
+    R51(e1, a1, b1, c1, d1, w10, 12);
+    R52(e2, a2, b2, c2, d2, w7, 6);
+    R51(d1, e1, a1, b1, c1, w14, 5);
+    R52(d2, e2, a2, b2, c2, w6, 8);
+    R51(c1, d1, e1, a1, b1, w1, 12);
+    R52(c2, d2, e2, a2, b2, w2, 13);
+    R51(b1, c1, d1, e1, a1, w3, 13);
+    R52(b2, c2, d2, e2, a2, w13, 6);
+    R51(a1, b1, c1, d1, e1, w8, 14);
+    R52(a2, b2, c2, d2, e2, w14, 5);
+    R51(e1, a1, b1, c1, d1, w11, 11);
+    R52(e2, a2, b2, c2, d2, w0, 15);
+    R51(d1, e1, a1, b1, c1, w6, 8);
+    R52(d2, e2, a2, b2, c2, w3, 13);
+    R51(c1, d1, e1, a1, b1, w15, 5);
+    R52(c2, d2, e2, a2, b2, w9, 11);
+    R51(b1, c1, d1, e1, a1, w13, 6);
+    R52(b2, c2, d2, e2, a2, w11, 11);
+
+    uint32_t s[5][8];
+    _mm256_storeu_si256((__m256i*)s[0], Add(Add(K(0xEFCDAB89ul), c1), d2));
+    _mm256_storeu_si256((__m256i*)s[1], Add(Add(K(0x98BADCFEul), d1), e2));
+    _mm256_storeu_si256((__m256i*)s[2], Add(Add(K(0x10325476ul), e1), a2));
+    _mm256_storeu_si256((__m256i*)s[3], Add(Add(K(0xC3D2E1F0ul), a1), b2));
+    _mm256_storeu_si256((__m256i*)s[4], Add(Add(K(0x67452301ul), b1), c2));
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 5; j++) WriteLE32(out[i] + 4 * j, s[j][i]);
+    }
+}
+
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
+#endif
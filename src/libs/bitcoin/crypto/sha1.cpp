@@ -5,6 +5,7 @@
 #include "crypto/sha1.h"
 
 #include "crypto/common.h"
+#include "crypto/kernels.h"
 
 #include <string.h>
 
@@ -142,8 +143,44 @@ void Transform(uint32_t* s, const unsigned char* chunk)
 
 } // namespace sha1
 
+typedef void (*TransformType)(uint32_t*, const unsigned char*);
+
+bool SelfTest(TransformType tr) {
+    // The padded empty string
+    static const unsigned char in[64] = {0x80};
+    static const uint32_t out[5] = {
+        0xda39a3eeul, 0x5e6b4b0dul, 0x3255bfeful, 0x95601890ul, 0xafd80709ul
+    };
+    uint32_t buf[5];
+    sha1::Initialize(buf);
+    tr(buf, in);
+    return memcmp(buf, out, sizeof(buf)) == 0;
+}
+
+const KernelChoice<TransformType> TRANSFORMS[] = {
+    {"standard", sha1::Transform, nullptr},
+};
+
+TransformType Transform = sha1::Transform;
+const char* TransformName = "standard";
+
 } // namespace
 
+std::vector<std::string> SHA1Kernels()
+{
+    return KernelNames(TRANSFORMS);
+}
+
+bool SHA1SelectKernel(const std::string& name)
+{
+    return SelectKernel(TRANSFORMS, name, SelfTest, Transform, TransformName);
+}
+
+std::string SHA1Kernel()
+{
+    return TransformName;
+}
+
 ////// SHA1
 
 CSHA1::CSHA1() : bytes(0)
@@ -160,12 +197,12 @@ CSHA1& CSHA1::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 64 - bufsize);
         bytes += 64 - bufsize;
         data += 64 - bufsize;
-        sha1::Transform(s, buf);
+        Transform(s, buf);
         bufsize = 0;
     }
     while (end >= data + 64) {
         // Process full chunks directly from the source.
-        sha1::Transform(s, data);
+        Transform(s, data);
         bytes += 64;
         data += 64;
     }
@@ -4,14 +4,25 @@
 
 #include "crypto/sha256.h"
 #include "crypto/common.h"
+#include "crypto/kernels.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 #include <atomic>
 
 #if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+namespace sha256_avx2
+{
+void Transform_8way(uint32_t* s, const unsigned char* const chunks[8]);
+}
+namespace sha256_shani
+{
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+}
+#endif
 #if defined(USE_ASM)
-#include <cpuid.h>
 namespace sha256_sse4
 {
 void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
@@ -172,23 +183,187 @@ bool SelfTest(TransformType tr) {
     return true;
 }
 
+/** Hashes n messages of len bytes each. */
+typedef void (*BatchType)(const unsigned char* const*, unsigned char* const*, size_t, size_t);
+
+void BatchSerial(const unsigned char* const* inputs, unsigned char* const* outputs, size_t n, size_t len)
+{
+    for (size_t i = 0; i < n; i++) {
+        CSHA256().Write(inputs[i], len).Finalize(outputs[i]);
+    }
+}
+
+bool SelfTestBatch(BatchType batch) {
+    // Nine messages, so that a wide kernel also hands one to its fallback
+    static const unsigned char spaces[65] = {
+        0,
+        32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+        32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32
+    };
+    static const unsigned char out1[32] = {
+        0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55
+    };
+    static const unsigned char out2[32] = {
+        0xce, 0x41, 0x53, 0xb0, 0x14, 0x7c, 0x2a, 0x86, 0x3e, 0xd4, 0x29, 0x8e, 0xe0, 0x67, 0x6b, 0xc8,
+        0x79, 0xfc, 0x77, 0xa1, 0x2a, 0xbe, 0x1f, 0x49, 0xb2, 0xb0, 0x55, 0xdf, 0x10, 0x69, 0x52, 0x3e
+    };
+    const unsigned char* inputs[9];
+    unsigned char hashes[9][32];
+    unsigned char* outputs[9];
+    for (int i = 0; i < 9; i++) {
+        inputs[i] = spaces + 1;
+        outputs[i] = hashes[i];
+    }
+    // The empty string, then 64 spaces (unaligned)
+    batch(inputs, outputs, 9, 0);
+    for (int i = 0; i < 9; i++) {
+        if (memcmp(hashes[i], out1, 32)) return false;
+    }
+    batch(inputs, outputs, 9, 64);
+    for (int i = 0; i < 9; i++) {
+        if (memcmp(hashes[i], out2, 32)) return false;
+    }
+    return true;
+}
+
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+/** Advances eight interleaved states by one block each, see sha256_avx2::Transform_8way. */
+typedef void (*Transform8Type)(uint32_t*, const unsigned char* const[8]);
+
+/** Hashes eight messages of len bytes each through an 8-way transform. */
+void Batch8(Transform8Type tr, const unsigned char* const* inputs, unsigned char* const* outputs, size_t len)
+{
+    static const uint32_t init[8] = {0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul};
+    uint32_t s[64];
+    const unsigned char* chunks[8];
+    for (int i = 0; i < 64; i++) s[i] = init[i / 8];
+
+    // Full blocks straight from the inputs
+    const size_t blocks = len / 64;
+    for (size_t b = 0; b < blocks; b++) {
+        for (int i = 0; i < 8; i++) chunks[i] = inputs[i] + 64 * b;
+        tr(s, chunks);
+    }
+
+    // The rest, 0x80 and the bit length take one or two more blocks
+    const size_t rest = len % 64;
+    const size_t padBlocks = rest < 56 ? 1 : 2;
+    unsigned char pad[8][128];
+    for (int i = 0; i < 8; i++) {
+        memcpy(pad[i], inputs[i] + 64 * blocks, rest);
+        pad[i][rest] = 0x80;
+        memset(pad[i] + rest + 1, 0, 64 * padBlocks - rest - 9);
+        WriteBE64(pad[i] + 64 * padBlocks - 8, (uint64_t)len << 3);
+    }
+    for (size_t b = 0; b < padBlocks; b++) {
+        for (int i = 0; i < 8; i++) chunks[i] = pad[i] + 64 * b;
+        tr(s, chunks);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) WriteBE32(outputs[i] + 4 * j, s[j * 8 + i]);
+    }
+}
+
+void BatchAVX2(const unsigned char* const* inputs, unsigned char* const* outputs, size_t n, size_t len)
+{
+    while (n >= 8) {
+        Batch8(sha256_avx2::Transform_8way, inputs, outputs, len);
+        inputs += 8;
+        outputs += 8;
+        n -= 8;
+    }
+    BatchSerial(inputs, outputs, n, len);
+}
+
+bool HasAVX2() { return HasCpuFeature(CpuFeature::AVX2); }
+#endif
+#if defined(USE_ASM)
+bool HasSSE4() { return HasCpuFeature(CpuFeature::SSE41); }
+#endif
+#endif
+
+bool HasSHANI() { return HasCpuFeature(CpuFeature::SHANI) && HasCpuFeature(CpuFeature::SSE41); }
+
+/** Single-stream transforms, fastest first. */
+const KernelChoice<TransformType> TRANSFORMS[] = {
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+    {"shani", sha256_shani::Transform, HasSHANI},
+#endif
+#if defined(USE_ASM)
+    {"sse4", sha256_sse4::Transform, HasSSE4},
+#endif
+#endif
+    {"standard", sha256::Transform, nullptr},
+};
+
+/** Batch kernels, fastest first unless SHA-NI is there. */
+const KernelChoice<BatchType> BATCHES[] = {
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+    {"avx2", BatchAVX2, HasAVX2},
+#endif
+#endif
+    {"serial", BatchSerial, nullptr},
+};
+
 TransformType Transform = sha256::Transform;
+const char* TransformName = "standard";
+BatchType Batch = BatchSerial;
+const char* BatchName = "serial";
 
 } // namespace
 
+std::vector<std::string> SHA256Kernels()
+{
+    return KernelNames(TRANSFORMS);
+}
+
+bool SHA256SelectKernel(const std::string& name)
+{
+    return SelectKernel(TRANSFORMS, name, SelfTest, Transform, TransformName);
+}
+
+std::string SHA256Kernel()
+{
+    return TransformName;
+}
+
+std::vector<std::string> SHA256BatchKernels()
+{
+    std::vector<std::string> names = KernelNames(BATCHES);
+    // A single SHA-NI stream outruns eight AVX2 lanes
+    if (HasSHANI()) std::stable_partition(names.begin(), names.end(), [](const std::string& name) { return name == "serial"; });
+    return names;
+}
+
+bool SHA256BatchSelectKernel(const std::string& name)
+{
+    return SelectKernel(BATCHES, name, SelfTestBatch, Batch, BatchName);
+}
+
+std::string SHA256BatchKernel()
+{
+    return BatchName;
+}
+
 std::string SHA256AutoDetect()
 {
-#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
-    uint32_t eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 19) & 1) {
-        Transform = sha256_sse4::Transform;
-        assert(SelfTest(Transform));
-        return "sse4";
-    }
-#endif
+    bool ok = SHA256SelectKernel(SHA256Kernels().front());
+    ok = SHA256BatchSelectKernel(SHA256BatchKernels().front()) && ok;
+    assert(ok);
+
+    std::string ret = TransformName;
+    if (Batch != BatchSerial) ret += std::string(",") + BatchName + "(8way)";
+    return ret;
+}
 
-    assert(SelfTest(Transform));
-    return "standard";
+void SHA256Batch(const unsigned char* const inputs[], unsigned char* const outputs[], size_t n, size_t len)
+{
+    Batch(inputs, outputs, n, len);
 }
 
 ////// SHA-256
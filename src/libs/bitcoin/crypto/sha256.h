@@ -31,4 +31,11 @@ public:
  */
 std::string SHA256AutoDetect();
 
+/** Compute the SHA-256 of n independent messages of len bytes each:
+ *  outputs[i] (32 bytes) = SHA256(inputs[i]). Eight messages at a time go
+ *  through the AVX2 kernel if SHA256AutoDetect() chose it, the rest, and all
+ *  of them otherwise, one by one through the selected transform.
+ */
+void SHA256Batch(const unsigned char* const inputs[], unsigned char* const outputs[], size_t n, size_t len);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -0,0 +1,167 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "crypto/common.h"
+
+// Only this file is built for AVX2; sha256.cpp calls into it after
+// checking the CPU and the OS support it.
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace sha256_avx2 {
+namespace {
+
+__m256i inline K(uint32_t x) { return _mm256_set1_epi32(x); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z) { return Add(Add(x, y), z); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w) { return Add(Add(x, y), Add(z, w)); }
+__m256i inline Inc(__m256i& x, __m256i y, __m256i z, __m256i w) { x = Add(x, y, z, w); return x; }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Xor(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+__m256i inline ShR(__m256i x, int n) { return _mm256_srli_epi32(x, n); }
+__m256i inline ShL(__m256i x, int n) { return _mm256_slli_epi32(x, n); }
+
+__m256i inline Ch(__m256i x, __m256i y, __m256i z) { return Xor(z, And(x, Xor(y, z))); }
+__m256i inline Maj(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), And(z, Or(x, y))); }
+__m256i inline Sigma0(__m256i x) { return Xor(Or(ShR(x, 2), ShL(x, 30)), Or(ShR(x, 13), ShL(x, 19)), Or(ShR(x, 22), ShL(x, 10))); }
+__m256i inline Sigma1(__m256i x) { return Xor(Or(ShR(x, 6), ShL(x, 26)), Or(ShR(x, 11), ShL(x, 21)), Or(ShR(x, 25), ShL(x, 7))); }
+__m256i inline sigma0(__m256i x) { return Xor(Or(ShR(x, 7), ShL(x, 25)), Or(ShR(x, 18), ShL(x, 14)), ShR(x, 3)); }
+__m256i inline sigma1(__m256i x) { return Xor(Or(ShR(x, 17), ShL(x, 15)), Or(ShR(x, 19), ShL(x, 13)), ShR(x, 10)); }
+
+/** One round of SHA-256 in all eight lanes, kw being the round constant plus the message word. */
+void inline __attribute__((always_inline)) Round(__m256i a, __m256i b, __m256i c, __m256i& d, __m256i e, __m256i f, __m256i g, __m256i& h, __m256i kw)
+{
+    __m256i t1 = Add(h, Sigma1(e), Ch(e, f, g), kw);
+    __m256i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+/** The big-endian message word at offset of every lane's chunk. */
+__m256i inline Read8(const unsigned char* const chunks[8], int offset)
+{
+    __m256i ret = _mm256_set_epi32(
+        ReadLE32(chunks[7] + offset), ReadLE32(chunks[6] + offset), ReadLE32(chunks[5] + offset), ReadLE32(chunks[4] + offset),
+        ReadLE32(chunks[3] + offset), ReadLE32(chunks[2] + offset), ReadLE32(chunks[1] + offset), ReadLE32(chunks[0] + offset));
+    return _mm256_shuffle_epi8(ret, _mm256_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL, 0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+}
+
+} // namespace
+
+/** Perform one SHA-256 transformation in each of eight independent states,
+ *  lane i processing the 64-byte chunks[i]. The states are interleaved:
+ *  word j of lane i is s[j * 8 + i]. */
+void Transform_8way(uint32_t* s, const unsigned char* const chunks[8])
+{
+    __m256i a = _mm256_loadu_si256((const __m256i*)(s + 0));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(s + 8));
+    __m256i c = _mm256_loadu_si256((const __m256i*)(s + 16));
+    __m256i d = _mm256_loadu_si256((const __m256i*)(s + 24));
+    __m256i e = _mm256_loadu_si256((const __m256i*)(s + 32));
+    __m256i f = _mm256_loadu_si256((const __m256i*)(s + 40));
+    __m256i g = _mm256_loadu_si256((const __m256i*)(s + 48));
+    __m256i h = _mm256_loadu_si256((const __m256i*)(s + 56));
+    __m256i w0, w1, w2, w3, w4, w5, w6, w7, w8, w9, w10, w11, w12, w13, w14, w15;
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0x428a2f98), w0 = Read8(chunks, 0)));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x71374491), w1 = Read8(chunks, 4)));
+    Round(g, h, a, b, c, d, e, f, Add(K(0xb5c0fbcf), w2 = Read8(chunks, 8)));
+    Round(f, g, h, a, b, c, d, e, Add(K(0xe9b5dba5), w3 = Read8(chunks, 12)));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x3956c25b), w4 = Read8(chunks, 16)));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x59f111f1), w5 = Read8(chunks, 20)));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x923f82a4), w6 = Read8(chunks, 24)));
+    Round(b, c, d, e, f, g, h, a, Add(K(0xab1c5ed5), w7 = Read8(chunks, 28)));
+    Round(a, b, c, d, e, f, g, h, Add(K(0xd807aa98), w8 = Read8(chunks, 32)));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x12835b01), w9 = Read8(chunks, 36)));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x243185be), w10 = Read8(chunks, 40)));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x550c7dc3), w11 = Read8(chunks, 44)));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x72be5d74), w12 = Read8(chunks, 48)));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x80deb1fe), w13 = Read8(chunks, 52)));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x9bdc06a7), w14 = Read8(chunks, 56)));
+    Round(b, c, d, e, f, g, h, a, Add(K(0xc19bf174), w15 = Read8(chunks, 60)));
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0xe49b69c1), Inc(w0, sigma1(w14), w9, sigma0(w1))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0xefbe4786), Inc(w1, sigma1(w15), w10, sigma0(w2))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x0fc19dc6), Inc(w2, sigma1(w0), w11, sigma0(w3))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x240ca1cc), Inc(w3, sigma1(w1), w12, sigma0(w4))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x2de92c6f), Inc(w4, sigma1(w2), w13, sigma0(w5))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x4a7484aa), Inc(w5, sigma1(w3), w14, sigma0(w6))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x5cb0a9dc), Inc(w6, sigma1(w4), w15, sigma0(w7))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x76f988da), Inc(w7, sigma1(w5), w0, sigma0(w8))));
+    Round(a, b, c, d, e, f, g, h, Add(K(0x983e5152), Inc(w8, sigma1(w6), w1, sigma0(w9))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0xa831c66d), Inc(w9, sigma1(w7), w2, sigma0(w10))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0xb00327c8), Inc(w10, sigma1(w8), w3, sigma0(w11))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0xbf597fc7), Inc(w11, sigma1(w9), w4, sigma0(w12))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0xc6e00bf3), Inc(w12, sigma1(w10), w5, sigma0(w13))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0xd5a79147), Inc(w13, sigma1(w11), w6, sigma0(w14))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x06ca6351), Inc(w14, sigma1(w12), w7, sigma0(w15))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x14292967), Inc(w15, sigma1(w13), w8, sigma0(w0))));
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0x27b70a85), Inc(w0, sigma1(w14), w9, sigma0(w1))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x2e1b2138), Inc(w1, sigma1(w15), w10, sigma0(w2))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x4d2c6dfc), Inc(w2, sigma1(w0), w11, sigma0(w3))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x53380d13), Inc(w3, sigma1(w1), w12, sigma0(w4))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x650a7354), Inc(w4, sigma1(w2), w13, sigma0(w5))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x766a0abb), Inc(w5, sigma1(w3), w14, sigma0(w6))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x81c2c92e), Inc(w6, sigma1(w4), w15, sigma0(w7))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x92722c85), Inc(w7, sigma1(w5), w0, sigma0(w8))));
+    Round(a, b, c, d, e, f, g, h, Add(K(0xa2bfe8a1), Inc(w8, sigma1(w6), w1, sigma0(w9))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0xa81a664b), Inc(w9, sigma1(w7), w2, sigma0(w10))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0xc24b8b70), Inc(w10, sigma1(w8), w3, sigma0(w11))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0xc76c51a3), Inc(w11, sigma1(w9), w4, sigma0(w12))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0xd192e819), Inc(w12, sigma1(w10), w5, sigma0(w13))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0xd6990624), Inc(w13, sigma1(w11), w6, sigma0(w14))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0xf40e3585), Inc(w14, sigma1(w12), w7, sigma0(w15))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x106aa070), Inc(w15, sigma1(w13), w8, sigma0(w0))));
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0x19a4c116), Inc(w0, sigma1(w14), w9, sigma0(w1))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x1e376c08), Inc(w1, sigma1(w15), w10, sigma0(w2))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x2748774c), Inc(w2, sigma1(w0), w11, sigma0(w3))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x34b0bcb5), Inc(w3, sigma1(w1), w12, sigma0(w4))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x391c0cb3), Inc(w4, sigma1(w2), w13, sigma0(w5))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x4ed8aa4a), Inc(w5, sigma1(w3), w14, sigma0(w6))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x5b9cca4f), Inc(w6, sigma1(w4), w15, sigma0(w7))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x682e6ff3), Inc(w7, sigma1(w5), w0, sigma0(w8))));
+    Round(a, b, c, d, e, f, g, h, Add(K(0x748f82ee), Inc(w8, sigma1(w6), w1, sigma0(w9))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x78a5636f), Inc(w9, sigma1(w7), w2, sigma0(w10))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x84c87814), Inc(w10, sigma1(w8), w3, sigma0(w11))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x8cc70208), Inc(w11, sigma1(w9), w4, sigma0(w12))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x90befffa), Inc(w12, sigma1(w10), w5, sigma0(w13))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0xa4506ceb), Inc(w13, sigma1(w11), w6, sigma0(w14))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0xbef9a3f7), Add(w14, sigma1(w12), w7, sigma0(w15))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0xc67178f2), Add(w15, sigma1(w13), w8, sigma0(w0))));
+
+    _mm256_storeu_si256((__m256i*)(s + 0), Add(a, _mm256_loadu_si256((const __m256i*)(s + 0))));
+    _mm256_storeu_si256((__m256i*)(s + 8), Add(b, _mm256_loadu_si256((const __m256i*)(s + 8))));
+    _mm256_storeu_si256((__m256i*)(s + 16), Add(c, _mm256_loadu_si256((const __m256i*)(s + 16))));
+    _mm256_storeu_si256((__m256i*)(s + 24), Add(d, _mm256_loadu_si256((const __m256i*)(s + 24))));
+    _mm256_storeu_si256((__m256i*)(s + 32), Add(e, _mm256_loadu_si256((const __m256i*)(s + 32))));
+    _mm256_storeu_si256((__m256i*)(s + 40), Add(f, _mm256_loadu_si256((const __m256i*)(s + 40))));
+    _mm256_storeu_si256((__m256i*)(s + 48), Add(g, _mm256_loadu_si256((const __m256i*)(s + 48))));
+    _mm256_storeu_si256((__m256i*)(s + 56), Add(h, _mm256_loadu_si256((const __m256i*)(s + 56))));
+}
+
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
+#endif
@@ -5,9 +5,19 @@
 #include "crypto/sha512.h"
 
 #include "crypto/common.h"
+#include "crypto/kernels.h"
 
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+namespace sha512_avx2
+{
+void Transform_4way(uint64_t* s, const unsigned char* const chunks[4]);
+}
+#endif
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -146,8 +156,200 @@ void Transform(uint64_t* s, const unsigned char* chunk)
 
 } // namespace sha512
 
+typedef void (*TransformType)(uint64_t*, const unsigned char*);
+
+bool SelfTest(TransformType tr) {
+    // The padded empty string
+    static const unsigned char in[128] = {0x80};
+    static const uint64_t out[8] = {
+        0xcf83e1357eefb8bdull, 0xf1542850d66d8007ull, 0xd620e4050b5715dcull, 0x83f4a921d36ce9ceull,
+        0x47d0d13c5d85f2b0ull, 0xff8318d2877eec2full, 0x63b931bd47417a81ull, 0xa538327af927da3eull
+    };
+    uint64_t buf[8];
+    sha512::Initialize(buf);
+    tr(buf, in);
+    return memcmp(buf, out, sizeof(buf)) == 0;
+}
+
+const KernelChoice<TransformType> TRANSFORMS[] = {
+    {"standard", sha512::Transform, nullptr},
+};
+
+TransformType Transform = sha512::Transform;
+const char* TransformName = "standard";
+
+/** The final one or two blocks of a message whose last rest bytes (less
+ *  than a block) are at data, total bytes long with its prefix, into tail.
+ *  Returns the number of blocks. */
+int PadTail(const unsigned char* data, size_t rest, uint64_t total, unsigned char* tail)
+{
+    const int blocks = rest < 112 ? 1 : 2;
+    memcpy(tail, data, rest);
+    tail[rest] = 0x80;
+    memset(tail + rest + 1, 0, blocks * 128 - rest - 1 - 8);
+    WriteBE64(tail + blocks * 128 - 8, total << 3);
+    return blocks;
+}
+
+/** Continues n hashes from states after prefix bytes with the n messages
+ *  of len bytes each, see SHA512Batch(). */
+typedef void (*BatchType)(const uint64_t* const*, uint64_t, const unsigned char* const*, unsigned char* const*, size_t, size_t);
+
+void BatchSerial(const uint64_t* const* states, uint64_t prefix, const unsigned char* const* inputs, unsigned char* const* outputs, size_t n, size_t len)
+{
+    unsigned char tail[256];
+    for (size_t i = 0; i < n; i++) {
+        uint64_t s[8];
+        if (states) {
+            memcpy(s, states[i], sizeof(s));
+        } else {
+            sha512::Initialize(s);
+        }
+        const unsigned char* data = inputs[i];
+        for (size_t done = 0; done + 128 <= len; done += 128, data += 128) {
+            Transform(s, data);
+        }
+        const int blocks = PadTail(data, len % 128, prefix + len, tail);
+        for (int k = 0; k < blocks; k++) {
+            Transform(s, tail + 128 * k);
+        }
+        for (int j = 0; j < 8; j++) WriteBE64(outputs[i] + 8 * j, s[j]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+void BatchAVX2(const uint64_t* const* states, uint64_t prefix, const unsigned char* const* inputs, unsigned char* const* outputs, size_t n, size_t len)
+{
+    uint64_t s[32];
+    unsigned char tails[4][256];
+    const unsigned char* chunks[4];
+
+    while (n >= 4) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t initial[8];
+            if (!states) sha512::Initialize(initial);
+            for (int j = 0; j < 8; j++) s[j * 4 + i] = states ? states[i][j] : initial[j];
+        }
+        // All lanes have the same length, hence the same blocks
+        size_t done = 0;
+        for (; done + 128 <= len; done += 128) {
+            for (int i = 0; i < 4; i++) chunks[i] = inputs[i] + done;
+            sha512_avx2::Transform_4way(s, chunks);
+        }
+        int blocks = 0;
+        for (int i = 0; i < 4; i++) blocks = PadTail(inputs[i] + done, len - done, prefix + len, tails[i]);
+        for (int k = 0; k < blocks; k++) {
+            for (int i = 0; i < 4; i++) chunks[i] = tails[i] + 128 * k;
+            sha512_avx2::Transform_4way(s, chunks);
+        }
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 8; j++) WriteBE64(outputs[i] + 8 * j, s[j * 4 + i]);
+        }
+
+        if (states) states += 4;
+        inputs += 4;
+        outputs += 4;
+        n -= 4;
+    }
+    BatchSerial(states, prefix, inputs, outputs, n, len);
+}
+
+bool HasAVX2() { return HasCpuFeature(CpuFeature::AVX2); }
+#endif
+#endif
+
+bool SelfTestBatch(BatchType batch) {
+    // Five distinct messages, so that every lane and the remainder get one,
+    // of lengths that pad into one and into two blocks, hashed afresh and
+    // from a midstate; against CSHA512
+    static const size_t lengths[] = {64, 112, 200};
+    unsigned char in[5][200];
+    unsigned char out[5][CSHA512::OUTPUT_SIZE];
+    unsigned char hash[CSHA512::OUTPUT_SIZE];
+    const unsigned char* inputs[5];
+    unsigned char* outputs[5];
+    uint64_t midstates[5][8];
+    const uint64_t* states[5];
+    for (int k = 0; k < 5; k++) {
+        for (int i = 0; i < 200; i++) in[k][i] = k * 64 + i * 7 + 1;
+        inputs[k] = in[k];
+        outputs[k] = out[k];
+        sha512::Initialize(midstates[k]);
+        sha512::Transform(midstates[k], in[k]);
+        states[k] = midstates[k];
+    }
+    for (size_t len : lengths) {
+        batch(nullptr, 0, inputs, outputs, 5, len);
+        for (int k = 0; k < 5; k++) {
+            CSHA512().Write(in[k], len).Finalize(hash);
+            if (memcmp(hash, out[k], sizeof(hash))) return false;
+        }
+        // The message after the 128 bytes that produced the midstate
+        batch(states, 128, inputs, outputs, 5, len);
+        for (int k = 0; k < 5; k++) {
+            CSHA512().Write(in[k], 128).Write(in[k], len).Finalize(hash);
+            if (memcmp(hash, out[k], sizeof(hash))) return false;
+        }
+    }
+    return true;
+}
+
+const KernelChoice<BatchType> BATCHES[] = {
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+    {"avx2", BatchAVX2, HasAVX2},
+#endif
+#endif
+    {"serial", BatchSerial, nullptr},
+};
+
+BatchType Batch = BatchSerial;
+const char* BatchName = "serial";
+
 } // namespace
 
+std::vector<std::string> SHA512Kernels()
+{
+    return KernelNames(TRANSFORMS);
+}
+
+bool SHA512SelectKernel(const std::string& name)
+{
+    return SelectKernel(TRANSFORMS, name, SelfTest, Transform, TransformName);
+}
+
+std::string SHA512Kernel()
+{
+    return TransformName;
+}
+
+std::vector<std::string> SHA512BatchKernels()
+{
+    return KernelNames(BATCHES);
+}
+
+bool SHA512BatchSelectKernel(const std::string& name)
+{
+    return SelectKernel(BATCHES, name, SelfTestBatch, Batch, BatchName);
+}
+
+std::string SHA512BatchKernel()
+{
+    return BatchName;
+}
+
+void SHA512Midstate(const unsigned char block[128], uint64_t state[8])
+{
+    sha512::Initialize(state);
+    Transform(state, block);
+}
+
+void SHA512Batch(const uint64_t* const states[], uint64_t prefix, const unsigned char* const inputs[], unsigned char* const outputs[], size_t n, size_t len)
+{
+    Batch(states, prefix, inputs, outputs, n, len);
+}
+
 
 ////// SHA-512
 
@@ -165,12 +367,12 @@ CSHA512& CSHA512::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 128 - bufsize);
         bytes += 128 - bufsize;
         data += 128 - bufsize;
-        sha512::Transform(s, buf);
+        Transform(s, buf);
         bufsize = 0;
     }
     while (end >= data + 128) {
         // Process full chunks directly from the source.
-        sha512::Transform(s, data);
+        Transform(s, data);
         data += 128;
         bytes += 128;
     }
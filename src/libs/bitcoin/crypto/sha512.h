@@ -25,4 +25,18 @@ public:
     CSHA512& Reset();
 };
 
+/** The SHA-512 state after hashing the 128-byte block, to continue from
+ *  with SHA512Batch(). */
+void SHA512Midstate(const unsigned char block[128], uint64_t state[8]);
+
+/** Compute the SHA-512 of n independent messages of len bytes each. Hash i
+ *  continues from states[i], the state after prefix bytes (a multiple of
+ *  128), or starts afresh for all if states is nullptr and prefix 0:
+ *  outputs[i] (64 bytes) is the hash of those prefix bytes followed by
+ *  inputs[i]. Four messages at a time go through the AVX2 kernel if it is
+ *  selected, the rest, and all of them otherwise, one by one through the
+ *  selected transform.
+ */
+void SHA512Batch(const uint64_t* const states[], uint64_t prefix, const unsigned char* const inputs[], unsigned char* const outputs[], size_t n, size_t len);
+
 #endif // BITCOIN_CRYPTO_SHA512_H
@@ -0,0 +1,88 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+[[noreturn]] static void RandFailure()
+{
+    fprintf(stderr, "Failed to read randomness, aborting\n");
+    abort();
+}
+
+#ifndef _WIN32
+/** Fallback: get num bytes of randomness from /dev/urandom. */
+static void GetDevURandom(unsigned char* buf, size_t num)
+{
+    int f = open("/dev/urandom", O_RDONLY);
+    if (f == -1) {
+        RandFailure();
+    }
+    size_t have = 0;
+    while (have < num) {
+        ssize_t n = read(f, buf + have, num - have);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            close(f);
+            RandFailure();
+        }
+        have += n;
+    }
+    close(f);
+}
+#endif
+
+void GetStrongRandBytes(unsigned char* buf, size_t num)
+{
+#ifdef _WIN32
+    if (!BCRYPT_SUCCESS(BCryptGenRandom(nullptr, buf, ULONG(num), BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+        RandFailure();
+    }
+#elif defined(__linux__) && defined(SYS_getrandom)
+    /* Linux. From the getrandom(2) man page:
+     * "If the urandom source has been initialized, reads of up to 256 bytes
+     * will always return as many bytes as requested and will not be
+     * interrupted by signals."
+     * Larger requests are split, and kernels without the system call fall
+     * back to /dev/urandom.
+     */
+    size_t have = 0;
+    while (have < num) {
+        long n = syscall(SYS_getrandom, buf + have, num - have < 256 ? num - have : 256, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == ENOSYS) {
+            GetDevURandom(buf + have, num - have);
+            return;
+        }
+        if (n <= 0) {
+            RandFailure();
+        }
+        have += n;
+    }
+#else
+    /* Fall back to /dev/urandom if there is no specific method implemented to
+     * get system randomness for this OS.
+     */
+    GetDevURandom(buf, num);
+#endif
+}
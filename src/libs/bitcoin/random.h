@@ -0,0 +1,21 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RANDOM_H
+#define BITCOIN_RANDOM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Fill buf with num bytes from the operating system's cryptographically
+ * secure random number generator: getrandom() or /dev/urandom on POSIX,
+ * BCryptGenRandom() on Windows. Use it for key material, never
+ * std::random_device, which may be deterministic (older MinGW).
+ * Aborts if the generator fails, there is no safe fallback.
+ */
+void GetStrongRandBytes(unsigned char* buf, size_t num);
+
+#endif // BITCOIN_RANDOM_H
@@ -1,13 +1,37 @@
 //https://github.com/ThePiachu/GoBitTest/tree/master/app
 //https://gobittest.appspot.com
 #include "bitcointests.h"
+#include "crypto/kernels.h"
+#include "vanitybench.h"
+#include "vanitypool.h"
+#include "vanityscheduler.h"
 #include <QApplication>
+#include <string>
 
 int main(int argc, char *argv[])
 {
     setbuf(stderr, 0);
     setbuf(stdout, NULL);
 
+    // Fastest hash kernels this CPU supports, or those the environment
+    // asks for, for every mode below
+    std::string kernelError;
+    HashKernelsAutoDetect(&kernelError);
+    if (!kernelError.empty())
+        fprintf(stderr, "%s: %s\n", HASH_KERNELS_ENV, kernelError.c_str());
+
+    // Headless vanity searches: spread over several processes or machines,
+    // or many orders scheduled on this one; or their throughput per mode
+    if (argc > 1) {
+        const std::string mode = argv[1];
+        if (mode == "--coordinator" || mode == "--worker")
+            return cosmyc::VanityPoolMain(argc, argv);
+        if (mode == "--scheduler")
+            return cosmyc::VanitySchedulerMain(argc, argv);
+        if (mode == "--bench")
+            return cosmyc::VanityBenchMain(argc, argv);
+    }
+
     QApplication a(argc, argv);
     BitcoinTests w;
     w.init("v1.0.4");
@@ -1,24 +1,31 @@
 
-#include <math.h>
+#include <cmath>
+#include <QRegExp>
 #include "vanity.h"
+#include "vanitypattern.h"
 
 
-const double cosmyc::Vanity::PatternComplexity(const QString pattern)
+QStringList cosmyc::Vanity::SplitPatterns(const QString patterns)
 {
-    double res = 1;
-    int index = 0;
+    return patterns.split(QRegExp("[\\s,;]+"), QString::SkipEmptyParts);
+}
 
-    while(pattern[++index] == '1'
-          && index <= pattern.size()) {
-        res *= 256;
+const double cosmyc::Vanity::PatternComplexity(const QString patterns)
+{
+    // Shared with the search engine, which has no Qt.
+    // The chances of the patterns to match add up
+    double odds = 0;
+    for (const QString &pattern : SplitPatterns(patterns)) {
+        const double complexity = VanityPattern::Complexity(STD_STRING(pattern));
+        if (std::isinf(complexity))
+            return complexity;
+        odds += 1 / complexity;
     }
 
-    return res * pow(double(58), double(pattern.size() - index)); // 58^m
+    return odds > 0 ? 1 / odds : INFINITY;
 }
 
 const double cosmyc::Vanity::PatternLavishness(const uint64_t bounty, const double pattern_compl)
 {
-    // b - vanity address bounty (in Bitcoins)
-    // c - vanity address complexity
-    return 0x100000000 * (bounty / pattern_compl); // 2^32 * (b/c)
+    return VanityPattern::Lavishness(bounty, pattern_compl);
 }
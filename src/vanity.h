@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <QStringList>
+
 #include "helper.h"
 
 namespace cosmyc {
@@ -9,7 +11,17 @@ namespace cosmyc {
 class Vanity
 {
 public:
-    static const double PatternComplexity(const QString pattern);
+    /// Patterns of a list separated by spaces, commas or semicolons, as
+    /// the vanity search takes them
+    static QStringList SplitPatterns(const QString patterns);
+
+    /// Expected number of addresses tested until one starts with any of
+    /// patterns (see SplitPatterns()). Each pattern counts with the exact
+    /// share of the hash160 range its addresses cover (see
+    /// VanityPattern::Complexity), not with the old 58^m and 256 per
+    /// leading '1' estimate. Infinity if a pattern is invalid or there is
+    /// none.
+    static const double PatternComplexity(const QString patterns);
 
     static const double PatternLavishness(const uint64_t bounty, const double pattern_compl);
 };
@@ -0,0 +1,394 @@
+#include "vanitybench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <stdlib.h>
+#include <thread>
+
+#include "crypto/checksum.h"
+#include "crypto/hash160.h"
+#include "crypto/hmac_sha512.h"
+#include "crypto/kernels.h"
+#include "crypto/ripemd160.h"
+#include "crypto/sha1.h"
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+#include "vanitypattern.h"
+
+namespace {
+
+const unsigned  DEFAULT_SECONDS = 5;
+const unsigned  DEFAULT_KERNEL_SECONDS = 1;
+const size_t    PATTERN_CHECK_SAMPLES = 1000000;
+
+/// Prefixes nobody finds within a benchmark, so no run ends early and no
+/// time goes into encoding matches
+struct BenchCase
+{
+    const char              *name;
+    const char              *pattern;
+    cosmyc::KEY_FORMATS     formats;
+};
+
+const BenchCase BENCH_CASES[] = {
+    { "P2PKH uncompressed", "11111111111111",       cosmyc::kfUncompressed },
+    { "P2PKH compressed",   "11111111111111",       cosmyc::kfCompressed },
+    { "P2PKH both",         "11111111111111",       cosmyc::kfBoth },
+    { "P2WPKH",             "bc1qqqqqqqqqqqqqqqqq", cosmyc::kfCompressed },
+    { "P2TR",               "bc1pqqqqqqqqqqqqqqqq", cosmyc::kfCompressed },
+};
+
+/// What each primitive hashes here: a key or hash of messageSize bytes,
+/// messages per call. Each run hashes its own output again, so nothing
+/// is optimized away.
+struct KernelWorkload
+{
+    const char      *primitive;
+    size_t          messageSize;
+    size_t          messages;
+    void            (*run)(unsigned char *data, size_t messageSize, size_t messages);
+};
+
+const size_t BATCH_MESSAGES = 64;
+
+const KernelWorkload KERNEL_WORKLOADS[] = {
+    { "sha256", 32, 1, [](unsigned char *data, size_t size, size_t) {
+        CSHA256().Write(data, size).Finalize(data);
+    } },
+    { "sha256batch", 33, BATCH_MESSAGES, [](unsigned char *data, size_t size, size_t messages) {
+        const unsigned char *inputs[BATCH_MESSAGES];
+        unsigned char *outputs[BATCH_MESSAGES];
+        for (size_t k = 0; k < messages; k++) {
+            inputs[k] = data + k * size;
+            outputs[k] = data + k * size;
+        }
+        SHA256Batch(inputs, outputs, messages, size);
+    } },
+    { "hash160", 33, 1, [](unsigned char *data, size_t, size_t) {
+        Hash160Compressed(data, data + 1);
+    } },
+    { "checksum", 34, 1, [](unsigned char *data, size_t size, size_t) {
+        SHA256d_Checksum(data, size, data);
+    } },
+    { "checksumbatch", 34, BATCH_MESSAGES, [](unsigned char *data, size_t size, size_t messages) {
+        const unsigned char *inputs[BATCH_MESSAGES];
+        unsigned char *outputs[BATCH_MESSAGES];
+        for (size_t k = 0; k < messages; k++) {
+            inputs[k] = data + k * size;
+            outputs[k] = data + k * size;
+        }
+        SHA256d_ChecksumBatch(inputs, outputs, messages, size);
+    } },
+    { "ripemd160", 32, 1, [](unsigned char *data, size_t size, size_t) {
+        CRIPEMD160().Write(data, size).Finalize(data);
+    } },
+    { "ripemd160batch", 32, BATCH_MESSAGES, [](unsigned char *data, size_t size, size_t messages) {
+        const unsigned char *inputs[BATCH_MESSAGES];
+        unsigned char *outputs[BATCH_MESSAGES];
+        for (size_t k = 0; k < messages; k++) {
+            inputs[k] = data + k * size;
+            outputs[k] = data + k * size;
+        }
+        RIPEMD160Batch32(inputs, outputs, messages);
+    } },
+    { "sha512", 64, 1, [](unsigned char *data, size_t size, size_t) {
+        CSHA512().Write(data, size).Finalize(data);
+    } },
+    // One round of PBKDF2-HMAC-SHA512, as in mnemonic seed stretching
+    { "sha512batch", 64, BATCH_MESSAGES, [](unsigned char *data, size_t size, size_t messages) {
+        static const CHMAC_SHA512Pads pads(reinterpret_cast<const unsigned char *>("mnemonic"), 8);
+        const CHMAC_SHA512Pads *keys[BATCH_MESSAGES];
+        const unsigned char *inputs[BATCH_MESSAGES];
+        unsigned char *outputs[BATCH_MESSAGES];
+        for (size_t k = 0; k < messages; k++) {
+            keys[k] = &pads;
+            inputs[k] = data + k * size;
+            outputs[k] = data + k * size;
+        }
+        HMAC_SHA512Batch(keys, inputs, outputs, messages, size);
+    } },
+    { "sha1", 64, 1, [](unsigned char *data, size_t size, size_t) {
+        CSHA1().Write(data, size).Finalize(data);
+    } },
+};
+
+/// Messages per second, and relative to the selected kernel
+int printKernels(const std::vector<cosmyc::HashKernelBenchResult> &results)
+{
+    std::cout << "selected: " << HashKernelsSummary() << "\n";
+    if (results.empty())
+        return 1;
+
+    std::cout << std::left << std::setw(16) << "primitive" << std::setw(12) << "kernel"
+              << std::right << std::setw(8) << "bytes" << std::setw(14) << "messages/s"
+              << std::setw(10) << "relative" << "\n";
+
+    for (const auto &result : results) {
+        double reference = 0;
+        for (const auto &other : results) {
+            if (other.primitive == result.primitive && other.selected)
+                reference = other.messagesPerSecond;
+        }
+
+        std::cout << std::left << std::setw(16) << result.primitive
+                  << std::setw(12) << (result.kernel + (result.selected ? "*" : ""))
+                  << std::right << std::setw(8) << result.messageSize
+                  << std::fixed << std::setprecision(0) << std::setw(14) << result.messagesPerSecond
+                  << std::setprecision(2) << std::setw(9) << (reference > 0 ? result.messagesPerSecond / reference : 0) << "x\n";
+    }
+    return 0;
+}
+
+const std::vector<cosmyc::PLACEMENT_POLICY> ALL_POLICIES = {
+    cosmyc::ppNone, cosmyc::ppCompact, cosmyc::ppSpread, cosmyc::ppPhysical
+};
+
+/// Keys per second, speedup over one thread of the same policy and
+/// efficiency per thread
+int printScaling(const std::vector<cosmyc::VanityScalingResult> &results)
+{
+    const cosmyc::CpuTopology &topology = cosmyc::CpuTopology::Get();
+
+    std::cout << topology.Cpus().size() << " logical CPUs, " << topology.PhysicalCores()
+              << " physical cores, " << topology.Nodes() << " NUMA nodes"
+              << (topology.CanPin() ? "" : ", no pinning") << "\n";
+    if (results.empty())
+        return 1;
+
+    std::cout << std::left << std::setw(12) << "placement"
+              << std::right << std::setw(8) << "threads" << std::setw(14) << "keys/s"
+              << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << "\n";
+
+    double single = 0;
+    for (const auto &result : results) {
+        if (result.threads == 1)
+            single = result.keysPerSecond;
+
+        const double speedup = single > 0 ? result.keysPerSecond / single : 0;
+        std::cout << std::left << std::setw(12) << cosmyc::CpuTopology::PolicyName(result.policy)
+                  << std::right << std::setw(8) << result.threads
+                  << std::fixed << std::setprecision(0) << std::setw(14) << result.keysPerSecond
+                  << std::setprecision(2) << std::setw(9) << speedup << "x"
+                  << std::setprecision(0) << std::setw(11) << 100 * speedup / result.threads << "%\n";
+    }
+    return 0;
+}
+
+int checkPatterns(const std::vector<std::string> &patterns)
+{
+    cosmyc::VanityPatternSet set;
+    size_t ranges = 0;
+    for (const auto &pattern : patterns) {
+        if (!set.Add(pattern)) {
+            std::cerr << "invalid pattern " << pattern << "\n";
+            return 2;
+        }
+        ranges += set.Pattern(set.Size() - 1).Ranges().size();
+    }
+    if (set.Size() == 0)
+        return 2;
+    set.Build();
+
+    const size_t mismatches = set.SelfCheck(PATTERN_CHECK_SAMPLES);
+    std::cout << set.Size() << " patterns, " << ranges << " ranges, "
+              << mismatches << " mismatches\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+} // namespace
+
+
+std::vector<cosmyc::VanityBenchResult> cosmyc::VanityBench(unsigned seconds, unsigned threads)
+{
+    std::vector<VanityBenchResult> results;
+
+    for (bool symmetries : { false, true }) {
+        for (const BenchCase &bench : BENCH_CASES) {
+            VanitySearch search;
+            search.SetSymmetries(symmetries);
+            if (!search.Start(bench.pattern, threads, bench.formats, true))
+                continue;
+
+            std::this_thread::sleep_for(std::chrono::seconds(seconds));
+            search.Stop();
+
+            const VanityReport report = search.Report();
+
+            VanityBenchResult result;
+            result.name = bench.name;
+            result.type = VanityPattern::TypeOf(bench.pattern);
+            result.formats = bench.formats;
+            result.symmetries = symmetries;
+            result.keysPerSecond = report.keysPerSecond;
+            result.hash160sPerSecond = report.hash160sPerSecond;
+            result.addressesPerSecond = report.addressesPerSecond;
+            results.push_back(result);
+        }
+    }
+
+    return results;
+}
+
+std::vector<cosmyc::VanityScalingResult> cosmyc::VanityScaling(
+            unsigned                        seconds,
+    const   std::vector<PLACEMENT_POLICY>   &policies,
+            unsigned                        maxThreads)
+{
+    const CpuTopology &topology = CpuTopology::Get();
+    if (maxThreads == 0)
+        maxThreads = unsigned(topology.Cpus().size());
+
+    std::set<unsigned> counts;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+        counts.insert(threads);
+    for (unsigned threads : { topology.PhysicalCores(), unsigned(topology.Cpus().size()), maxThreads }) {
+        if (threads <= maxThreads)
+            counts.insert(threads);
+    }
+
+    std::vector<VanityScalingResult> results;
+    for (PLACEMENT_POLICY policy : policies) {
+        for (unsigned threads : counts) {
+            VanitySearch search;
+            search.SetPlacement(policy);
+            if (!search.Start(BENCH_CASES[1].pattern, threads, kfCompressed, true))
+                continue;
+
+            std::this_thread::sleep_for(std::chrono::seconds(seconds));
+            search.Stop();
+
+            VanityScalingResult result;
+            result.policy = policy;
+            result.threads = threads;
+            result.keysPerSecond = search.Report().keysPerSecond;
+            results.push_back(result);
+        }
+    }
+
+    return results;
+}
+
+std::vector<cosmyc::HashKernelBenchResult> cosmyc::HashKernelBench(double seconds)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<HashKernelBenchResult> results;
+
+    for (const HashKernels &kernels : ListHashKernels()) {
+        const KernelWorkload *workload = nullptr;
+        for (const KernelWorkload &candidate : KERNEL_WORKLOADS) {
+            if (kernels.primitive == candidate.primitive)
+                workload = &candidate;
+        }
+        if (!workload)
+            continue;
+
+        for (const std::string &kernel : kernels.available) {
+            if (!SelectHashKernel(kernels.primitive, kernel))
+                continue;
+
+            std::vector<unsigned char>  data(workload->messageSize * workload->messages, 0x5a);
+            uint64_t                    messages = 0;
+            const Clock::time_point     start = Clock::now();
+            double                      elapsed = 0;
+            while (elapsed < seconds) {
+                for (unsigned k = 0; k < 1024; k++)
+                    workload->run(data.data(), workload->messageSize, workload->messages);
+                messages += 1024 * workload->messages;
+                elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            }
+
+            HashKernelBenchResult result;
+            result.primitive = kernels.primitive;
+            result.kernel = kernel;
+            result.selected = kernel == kernels.selected;
+            result.messageSize = workload->messageSize;
+            result.messagesPerSecond = messages / elapsed;
+            results.push_back(result);
+        }
+        SelectHashKernel(kernels.primitive, kernels.selected);
+    }
+
+    return results;
+}
+
+int cosmyc::VanityBenchMain(int argc, char *argv[])
+{
+    unsigned                        seconds = DEFAULT_SECONDS;
+    unsigned                        threads = 0;
+    bool                            scaling = false;
+    bool                            kernels = false;
+    bool                            secondsSet = false;
+    std::vector<PLACEMENT_POLICY>   policies;
+
+    for (int k = 2; k < argc; k++) {
+        const std::string option = argv[k];
+        const bool hasValue = k + 1 < argc;
+
+        if (option == "--seconds" && hasValue) {
+            seconds = std::max(1, atoi(argv[++k]));
+            secondsSet = true;
+        } else if (option == "--threads" && hasValue) {
+            threads = unsigned(atoi(argv[++k]));
+        } else if (option == "--scaling") {
+            scaling = true;
+        } else if (option == "--kernels") {
+            kernels = true;
+        } else if (option == "--patterns") {
+            return checkPatterns(std::vector<std::string>(argv + k + 1, argv + argc));
+        } else if (option == "--placement" && hasValue) {
+            PLACEMENT_POLICY policy = ppNone;
+            if (!CpuTopology::ParsePolicy(argv[++k], policy)) {
+                std::cerr << "unknown placement " << argv[k] << "\n";
+                return 2;
+            }
+            policies.push_back(policy);
+        } else {
+            std::cerr
+                << "usage: " << argv[0] << " --bench [--seconds <per run>] [--threads <n>]\n"
+                << "       " << argv[0] << " --bench --scaling [--seconds <per run>] [--threads <max>]\n"
+                << "       [--placement none|compact|spread|physical]...\n"
+                << "       " << argv[0] << " --bench --kernels [--seconds <per kernel>]\n"
+                << "       " << argv[0] << " --bench --patterns <pattern>...\n";
+            return 2;
+        }
+    }
+
+    if (kernels)
+        return printKernels(HashKernelBench(secondsSet ? seconds : DEFAULT_KERNEL_SECONDS));
+    if (scaling)
+        return printScaling(VanityScaling(seconds, policies.empty() ? ALL_POLICIES : policies, threads));
+
+    const std::vector<VanityBenchResult> results = VanityBench(seconds, threads);
+    if (results.empty())
+        return 1;
+
+    // Addresses per second relative to the plain compressed P2PKH search.
+    // Not keys: with symmetries a P2TR key is worth half an address.
+    double reference = 0;
+    for (const auto &result : results) {
+        if (result.type == atP2PKH && result.formats == kfCompressed && !result.symmetries)
+            reference = result.addressesPerSecond;
+    }
+
+    std::cout << "hash kernels: " << HashKernelsSummary() << "\n";
+    std::cout << std::left << std::setw(20) << "address" << std::setw(12) << "symmetries"
+              << std::right << std::setw(14) << "keys/s" << std::setw(14) << "hash160s/s"
+              << std::setw(14) << "addresses/s" << std::setw(10) << "relative" << "\n";
+
+    for (const auto &result : results) {
+        std::cout << std::left << std::setw(20) << result.name
+                  << std::setw(12) << (result.symmetries ? "yes" : "no")
+                  << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(14) << result.keysPerSecond
+                  << std::setw(14) << result.hash160sPerSecond
+                  << std::setw(14) << result.addressesPerSecond
+                  << std::setprecision(2)
+                  << std::setw(9) << (reference > 0 ? result.addressesPerSecond / reference : 0) << "x\n";
+    }
+
+    return 0;
+}
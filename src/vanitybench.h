@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vanitysearch.h"
+
+namespace cosmyc {
+
+
+/// Throughput of one search configuration
+struct VanityBenchResult
+{
+    std::string     name;
+    ADDRESS_TYPE    type;
+    KEY_FORMATS     formats;
+    bool            symmetries;
+    double          keysPerSecond;
+    double          hash160sPerSecond;
+    double          addressesPerSecond; // what searches compare on, see VanityReport
+};
+
+/// Throughput of a search with some threads under one placement policy
+struct VanityScalingResult
+{
+    PLACEMENT_POLICY    policy;
+    unsigned            threads;
+    double              keysPerSecond;
+};
+
+/// Throughput of one kernel of a hash primitive
+struct HashKernelBenchResult
+{
+    std::string     primitive;
+    std::string     kernel;
+    bool            selected;       // the one chosen at startup
+    size_t          messageSize;    // bytes
+    double          messagesPerSecond;
+};
+
+/// Runs a search for seconds per configuration with a pattern that never
+/// matches and measures keys and hash160s per second: P2PKH with each key
+/// format, P2WPKH and P2TR, each without and with symmetries.
+/// threads == 0 means one thread per hardware thread.
+std::vector<VanityBenchResult> VanityBench(unsigned seconds, unsigned threads = 0);
+
+/// Scaling curve of a compressed P2PKH search under each of policies: 1,
+/// 2, 4 ... threads up to maxThreads, plus the number of physical cores
+/// and of logical CPUs on the way. maxThreads == 0 means one per logical
+/// CPU.
+std::vector<VanityScalingResult> VanityScaling(
+            unsigned                        seconds,
+    const   std::vector<PLACEMENT_POLICY>   &policies,
+            unsigned                        maxThreads = 0);
+
+/// Hashes messages of the size each primitive sees in this program with
+/// every kernel that runs here, for seconds per kernel, then restores the
+/// kernels selected before.
+std::vector<HashKernelBenchResult> HashKernelBench(double seconds);
+
+/// Command line front end (argv[1] is "--bench"): prints the results of
+/// VanityBench(), with --scaling of VanityScaling() or with --kernels of
+/// HashKernelBench(), as a table. With --patterns it instead runs
+/// VanityPatternSet::SelfCheck() on the patterns that follow.
+/// Returns the process exit code.
+int VanityBenchMain(int argc, char *argv[]);
+
+
+} // namespace cosmyc
@@ -0,0 +1,732 @@
+#include "vanitypattern.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <math.h>
+#include <random>
+#include <string.h>
+#include <utility>
+
+#include "arith_uint256.h"
+#include "base58.h"
+#include "bech32.h"
+#include "crypto/sha256.h"
+#include "utilstrencodings.h"
+
+namespace {
+
+const char      *BASE58_ALPHABET = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+/// Version byte, hash160, checksum
+const unsigned  PAYLOAD_SIZE = 25;
+
+/// Longest possible base58 form of a 25-byte payload
+const unsigned  MAX_ADDRESS_SIZE = 34;
+
+const char      *BECH32_ALPHABET = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+/// Human-readable part, separator and witness version 0 (P2WPKH) or
+/// 1 (P2TR)
+const char      *SEGWIT_PREFIX = "bc1q";
+const char      *TAPROOT_PREFIX = "bc1p";
+const size_t    SEGWIT_PREFIX_SIZE = 4;
+
+/// The 160 bits of a hash160 in 5-bit characters; a P2TR pattern is
+/// limited to as many, i.e. to the first 20 bytes of the x-only key
+const size_t    SEGWIT_HASH_CHARS = 32;
+
+/// x-only public key of a P2TR output
+const size_t    XONLY_SIZE = 32;
+
+/// Leading mark of a case-insensitive pattern, and the character that
+/// stands for any one character
+const char      CASE_INSENSITIVE = '~';
+const char      WILDCARD = '?';
+
+/// A base58 pattern whose digit sets would need more hash160 ranges than
+/// this is compiled for a shorter prefix and checked in full on a hit
+const size_t    MAX_RANGES = 4096;
+
+/// N = hash160 * 2^32 + checksum of a P2PKH payload is below 2^192
+const double    PAYLOAD_SPACE = 6277101735386680763835789423207666416102355444464034512896.0;
+
+/// Pattern without its case-insensitive mark
+std::string patternBody(const std::string &pattern, bool *insensitive = nullptr)
+{
+    const bool marked = !pattern.empty() && pattern[0] == CASE_INSENSITIVE;
+    if (insensitive)
+        *insensitive = marked;
+    return marked ? pattern.substr(1) : pattern;
+}
+
+char otherCase(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 'A';
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A' + 'a';
+    return c;
+}
+
+/// Digits (indices into alphabet) allowed at every position of pattern,
+/// as bit sets. Returns false if a position allows none.
+bool toDigitSets(
+    const   std::string             &pattern,
+    const   char                    *alphabet,
+            bool                    insensitive,
+            std::vector<uint64_t>   &sets)
+{
+    const uint64_t all = (uint64_t(1) << strlen(alphabet)) - 1;
+
+    sets.clear();
+    for (char c : pattern) {
+        uint64_t set = 0;
+        if (c == WILDCARD) {
+            set = all;
+        } else {
+            for (char option : { c, insensitive ? otherCase(c) : c }) {
+                const char *digit = option ? strchr(alphabet, option) : nullptr;
+                if (digit)
+                    set |= uint64_t(1) << (digit - alphabet);
+            }
+        }
+        if (set == 0)
+            return false;
+        sets.push_back(set);
+    }
+    return true;
+}
+
+size_t countDigits(uint64_t set)
+{
+    size_t count = 0;
+    for (; set; set &= set - 1)
+        count++;
+    return count;
+}
+
+/// Bech32 is case-insensitive, but an address is all lower or all upper case
+bool toSegwitCase(const std::string &pattern, std::string &lower)
+{
+    bool hasLower = false, hasUpper = false;
+    lower = pattern;
+    for (char &c : lower) {
+        if (c >= 'a' && c <= 'z')
+            hasLower = true;
+        if (c >= 'A' && c <= 'Z') {
+            hasUpper = true;
+            c = c - 'A' + 'a';
+        }
+    }
+    return !(hasLower && hasUpper);
+}
+
+arith_uint256 pow58(unsigned exponent)
+{
+    arith_uint256 result = 1;
+    while (exponent--)
+        result *= 58;
+    return result;
+}
+
+arith_uint256 pow256(unsigned exponent)
+{
+    return arith_uint256(1) << (8 * exponent);
+}
+
+/// Low size bytes of value, big-endian
+void toBytes(const arith_uint256 &value, unsigned char *out, size_t size)
+{
+    for (size_t k = 0; k < size; k++)
+        out[size - 1 - k] = (value >> (8 * k)).GetLow64() & 0xFF;
+}
+
+arith_uint256 fromBytes(const unsigned char *in, size_t size)
+{
+    arith_uint256 result = 0;
+    for (size_t k = 0; k < size; k++) {
+        result <<= 8;
+        result += in[k];
+    }
+    return result;
+}
+
+/// Values of sets.size() base58 digits, each one in its set, as sorted
+/// intervals [from, to). Returns false once that takes more than cap
+/// intervals.
+bool digitIntervals(
+    const   std::vector<uint64_t>                                   &sets,
+            size_t                                                  cap,
+            std::vector<std::pair<arith_uint256, arith_uint256> >   &intervals)
+{
+    const uint64_t all = (uint64_t(1) << 58) - 1;
+
+    intervals.assign(1, std::make_pair(arith_uint256(0), arith_uint256(1)));
+    for (uint64_t set : sets) {
+        // Runs of consecutive digits [first, second)
+        std::vector<std::pair<unsigned, unsigned> > runs;
+        for (unsigned digit = 0; digit < 58; digit++) {
+            if (!(set >> digit & 1))
+                continue;
+            if (!runs.empty() && runs.back().second == digit)
+                runs.back().second = digit + 1;
+            else
+                runs.push_back(std::make_pair(digit, digit + 1));
+        }
+
+        std::vector<std::pair<arith_uint256, arith_uint256> > next;
+        for (const auto &interval : intervals) {
+            // Any digit keeps an interval whole, others split it per value
+            if (set == all) {
+                next.push_back(std::make_pair(interval.first * 58, interval.second * 58));
+                continue;
+            }
+
+            const arith_uint256 width = interval.second - interval.first;
+            if (width > cap || next.size() + width.GetLow64() * runs.size() > cap)
+                return false;
+
+            for (arith_uint256 value = interval.first; value < interval.second; ++value) {
+                for (const auto &run : runs)
+                    next.push_back(std::make_pair(value * 58 + run.first, value * 58 + run.second));
+            }
+        }
+
+        intervals.clear();
+        for (const auto &interval : next) {
+            if (!intervals.empty() && intervals.back().second == interval.first)
+                intervals.back().second = interval.second;
+            else
+                intervals.push_back(interval);
+        }
+    }
+    return true;
+}
+
+/// Payload values N whose address matches the first digits sets, as
+/// intervals [from, to). Returns false if that takes more than MAX_RANGES.
+///
+/// Every leading '1' stands for one leading zero byte of the payload (the
+/// first one is the version byte), so each count of leading ones a
+/// pattern allows is its own case: the rest of the address is the base58
+/// form of N without leading zeros, and the N whose L-digit form starts
+/// with given digits form intervals that scale by 58^(L - digits).
+bool payloadRanges(
+    const   std::vector<uint64_t>                                   &sets,
+            size_t                                                  digits,
+            std::vector<std::pair<arith_uint256, arith_uint256> >   &ranges)
+{
+    ranges.clear();
+
+    for (unsigned ones = 1; ones <= digits && ones < PAYLOAD_SIZE; ones++) {
+        if (!(sets[ones - 1] & 1))
+            break;
+
+        // Payload values N with at least that many zero bytes are below
+        // high; with exactly that many they are also at least low
+        const arith_uint256 high = pow256(PAYLOAD_SIZE - ones);
+        const arith_uint256 low = pow256(PAYLOAD_SIZE - ones - 1);
+
+        if (ones == digits) {
+            // Only ones: more zero bytes than asked for match as well
+            ranges.push_back(std::make_pair(arith_uint256(0), high));
+            break;
+        }
+
+        // The digit after the ones is not a '1'
+        std::vector<uint64_t> rest(sets.begin() + ones, sets.begin() + digits);
+        rest[0] &= ~uint64_t(1);
+        if (rest[0] == 0)
+            continue;
+
+        std::vector<std::pair<arith_uint256, arith_uint256> > intervals;
+        if (!digitIntervals(rest, MAX_RANGES, intervals))
+            return false;
+
+        for (unsigned length = rest.size(); length <= MAX_ADDRESS_SIZE; length++) {
+            const arith_uint256 scale = pow58(length - rest.size());
+            if (intervals.front().first * scale >= high)
+                break;
+
+            for (const auto &interval : intervals) {
+                arith_uint256 from = interval.first * scale;
+                arith_uint256 to = interval.second * scale;
+
+                if (from >= high)
+                    break;
+                if (from < low)
+                    from = low;
+                if (to > high)
+                    to = high;
+                if (from < to)
+                    ranges.push_back(std::make_pair(from, to));
+            }
+        }
+
+        if (ranges.size() > MAX_RANGES)
+            return false;
+    }
+    return true;
+}
+
+/// First two bytes of a big-endian hash160
+unsigned radixOf(const unsigned char *hash160)
+{
+    return (hash160[0] << 8) | hash160[1];
+}
+
+} // namespace
+
+
+cosmyc::VanityPattern::VanityPattern()
+    : FType(atP2PKH)
+    , FExact(true)
+    , FComplexity(std::numeric_limits<double>::infinity())
+{
+    memset(FValue, 0, sizeof(FValue));
+    memset(FMask, 0, sizeof(FMask));
+}
+
+cosmyc::ADDRESS_TYPE cosmyc::VanityPattern::TypeOf(const std::string &pattern)
+{
+    const std::string body = patternBody(pattern);
+    if (body.size() < 3 || (body.compare(0, 3, "bc1") != 0 && body.compare(0, 3, "BC1") != 0))
+        return atP2PKH;
+
+    // The witness version character after the separator
+    return body.size() > 3 && (body[3] == 'p' || body[3] == 'P') ? atP2TR : atP2WPKH;
+}
+
+bool cosmyc::VanityPattern::IsValid(const std::string &pattern)
+{
+    bool                    insensitive = false;
+    const std::string       body = patternBody(pattern, &insensitive);
+    const ADDRESS_TYPE      type = TypeOf(pattern);
+    std::vector<uint64_t>   sets;
+
+    // Bech32 is case-insensitive anyway, the mark changes nothing there
+    if (type != atP2PKH) {
+        std::string lower;
+        return toSegwitCase(body, lower)
+                && lower.size() >= SEGWIT_PREFIX_SIZE
+                && lower.size() <= SEGWIT_PREFIX_SIZE + SEGWIT_HASH_CHARS
+                && lower.compare(0, SEGWIT_PREFIX_SIZE, type == atP2TR ? TAPROOT_PREFIX : SEGWIT_PREFIX) == 0
+                && toDigitSets(lower.substr(SEGWIT_PREFIX_SIZE), BECH32_ALPHABET, false, sets);
+    }
+
+    // P2PKH mainnet addresses are 25 bytes with a zero version byte,
+    // so they always start with '1' and are at most 34 characters long
+    return body.size() >= 1 && body.size() <= MAX_ADDRESS_SIZE
+            && toDigitSets(body, BASE58_ALPHABET, insensitive, sets)
+            && (sets[0] & 1) != 0;
+}
+
+double cosmyc::VanityPattern::Complexity(const std::string &pattern)
+{
+    VanityPattern compiled;
+    return compiled.Compile(pattern) ? compiled.Complexity() : std::numeric_limits<double>::infinity();
+}
+
+double cosmyc::VanityPattern::Lavishness(uint64_t bounty, double complexity)
+{
+    // b - vanity address bounty (in Bitcoins)
+    // c - vanity address complexity
+    return 0x100000000 * (bounty / complexity); // 2^32 * (b/c)
+}
+
+bool cosmyc::VanityPattern::Compile(const std::string &pattern)
+{
+    FPattern.clear();
+    FRanges.clear();
+    FSets.clear();
+    FExact = true;
+    FComplexity = std::numeric_limits<double>::infinity();
+
+    if (!IsValid(pattern))
+        return false;
+
+    FPattern = pattern;
+    FType = TypeOf(pattern);
+    if (FType != atP2PKH)
+        return CompileSegwit();
+
+    bool                insensitive = false;
+    const std::string   body = patternBody(pattern, &insensitive);
+    toDigitSets(body, BASE58_ALPHABET, insensitive, FSets);
+
+    // The first '1' is the version byte, whatever the pattern allows there
+    FSets[0] = 1;
+
+    // A pattern that needs too many ranges is compiled for its longest
+    // prefix that does not, and checked in full on a hit
+    std::vector<std::pair<arith_uint256, arith_uint256> > ranges;
+    size_t digits = FSets.size();
+    while (!payloadRanges(FSets, digits, ranges))
+        digits--;
+    FExact = digits == FSets.size();
+
+    // The share of all payloads the ranges cover is the odds of a match;
+    // digits past the compiled prefix are close enough to uniform
+    double probability = 0;
+    for (const auto &range : ranges)
+        probability += (range.second - range.first).getdouble() / PAYLOAD_SPACE;
+    for (size_t k = digits; k < FSets.size(); k++)
+        probability *= double(countDigits(FSets[k])) / 58;
+    if (probability > 0)
+        FComplexity = 1 / probability;
+
+    // N = hash160 * 2^32 + checksum, the checksum only matters for the
+    // hash160 values on the edges of a range
+    for (const auto &range : ranges) {
+        Hash160Range hashRange;
+        toBytes(range.first >> 32, hashRange.first, HASH160_SIZE);
+        toBytes((range.second - 1) >> 32, hashRange.last, HASH160_SIZE);
+        FRanges.push_back(hashRange);
+    }
+
+    return !FRanges.empty();
+}
+
+bool cosmyc::VanityPattern::CompileSegwit()
+{
+    std::string lower;
+    toSegwitCase(patternBody(FPattern), lower);
+
+    std::vector<uint64_t> sets;
+    toDigitSets(lower.substr(SEGWIT_PREFIX_SIZE), BECH32_ALPHABET, false, sets);
+
+    // The characters after "bc1q" or "bc1p" as 5-bit groups, and as many
+    // groups for the mask: all ones for a character, zero for a wildcard.
+    // Regrouped into bytes they are value and mask of the leading key
+    // bits. The range only covers the characters before the first
+    // wildcard, the mask tests the rest.
+    std::vector<uint8_t> groups, ones, prefix;
+    size_t fixed = 0;
+    for (uint64_t set : sets) {
+        const bool wildcard = countDigits(set) > 1;
+        groups.push_back(wildcard ? 0 : countDigits(set - 1));
+        ones.push_back(wildcard ? 0 : 0x1F);
+        prefix.push_back(wildcard || (!prefix.empty() && prefix.back() == 0) ? 0 : 0x1F);
+        fixed += wildcard ? 0 : 1;
+    }
+
+    std::vector<uint8_t> value, mask, prefixMask;
+    ConvertBits<5, 8, true>(value, groups.begin(), groups.end());
+    ConvertBits<5, 8, true>(mask, ones.begin(), ones.end());
+    ConvertBits<5, 8, true>(prefixMask, prefix.begin(), prefix.end());
+    value.resize(HASH160_SIZE, 0);
+    mask.resize(HASH160_SIZE, 0);
+    prefixMask.resize(HASH160_SIZE, 0);
+
+    // key & prefixMask == value & prefixMask is the range
+    // value & prefixMask .. value | ~prefixMask
+    Hash160Range range;
+    for (size_t k = 0; k < HASH160_SIZE; k++) {
+        range.first[k] = value[k] & prefixMask[k];
+        range.last[k] = value[k] | uint8_t(~prefixMask[k]);
+        FValue[k] = value[k];
+        FMask[k] = mask[k];
+    }
+    FRanges.push_back(range);
+
+    // Every character after "bc1q" or "bc1p" is 5 bits of the hash160 or
+    // the x-only key
+    FExact = fixed == sets.size();
+    FComplexity = pow(double(32), double(fixed));
+    return true;
+}
+
+const std::string &cosmyc::VanityPattern::Pattern() const
+{
+    return FPattern;
+}
+
+cosmyc::ADDRESS_TYPE cosmyc::VanityPattern::Type() const
+{
+    return FType;
+}
+
+double cosmyc::VanityPattern::Complexity() const
+{
+    return FComplexity;
+}
+
+const std::vector<cosmyc::Hash160Range> &cosmyc::VanityPattern::Ranges() const
+{
+    return FRanges;
+}
+
+bool cosmyc::VanityPattern::Match(const unsigned char *hash160) const
+{
+    for (const auto &range : FRanges) {
+        int first = memcmp(hash160, range.first, HASH160_SIZE);
+        int last = memcmp(hash160, range.last, HASH160_SIZE);
+
+        if (first < 0 || last > 0)
+            continue;
+
+        // A bech32 range is exact up to the first wildcard, only base58
+        // has a checksum in the number
+        if (FType != atP2PKH)
+            return FExact || Masked(hash160);
+        if (FExact && first > 0 && last < 0)
+            return true;
+
+        // On the edge, or past the compiled prefix, the address decides
+        return Accepts(EncodeAddress(hash160));
+    }
+    return false;
+}
+
+bool cosmyc::VanityPattern::Masked(const unsigned char *hash160) const
+{
+    for (size_t k = 0; k < HASH160_SIZE; k++) {
+        if ((hash160[k] & FMask[k]) != FValue[k])
+            return false;
+    }
+    return true;
+}
+
+bool cosmyc::VanityPattern::Accepts(const std::string &address) const
+{
+    if (address.size() < FSets.size())
+        return false;
+
+    for (size_t k = 0; k < FSets.size(); k++) {
+        const char *digit = strchr(BASE58_ALPHABET, address[k]);
+        if (!digit || !(FSets[k] >> (digit - BASE58_ALPHABET) & 1))
+            return false;
+    }
+    return true;
+}
+
+std::string cosmyc::VanityPattern::Address(const unsigned char *key) const
+{
+    switch (FType) {
+    case atP2WPKH:
+        return EncodeSegwitAddress(key);
+    case atP2TR:
+        return EncodeTaprootAddress(key);
+    default:
+        return EncodeAddress(key);
+    }
+}
+
+std::string cosmyc::VanityPattern::EncodeAddress(const unsigned char *hash160)
+{
+    unsigned char payload[PAYLOAD_SIZE];
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+
+    payload[0] = 0x00;
+    memcpy(payload + 1, hash160, HASH160_SIZE);
+
+    CSHA256().Write(payload, 1 + HASH160_SIZE).Finalize(hash);
+    CSHA256().Write(hash, sizeof(hash)).Finalize(hash);
+    memcpy(payload + 1 + HASH160_SIZE, hash, 4);
+
+    return EncodeBase58(payload, payload + sizeof(payload));
+}
+
+std::string cosmyc::VanityPattern::EncodeSegwitAddress(const unsigned char *hash160)
+{
+    std::vector<uint8_t> values(1, 0);  // witness version
+    ConvertBits<8, 5, true>(values, hash160, hash160 + HASH160_SIZE);
+    return bech32::Encode(bech32::Encoding::BECH32, "bc", values);
+}
+
+std::string cosmyc::VanityPattern::EncodeTaprootAddress(const unsigned char *xonly)
+{
+    std::vector<uint8_t> values(1, 1);  // witness version
+    ConvertBits<8, 5, true>(values, xonly, xonly + XONLY_SIZE);
+    return bech32::Encode(bech32::Encoding::BECH32M, "bc", values);
+}
+
+
+cosmyc::VanityPatternSet::VanityPatternSet()
+{
+}
+
+bool cosmyc::VanityPatternSet::Add(const std::string &pattern)
+{
+    VanityPattern compiled;
+    if (!compiled.Compile(pattern))
+        return false;
+
+    FPatterns.push_back(compiled);
+    return true;
+}
+
+void cosmyc::VanityPatternSet::Clear()
+{
+    FPatterns.clear();
+    FSegments.clear();
+    FSegmentPatterns.clear();
+    FIndex.clear();
+}
+
+void cosmyc::VanityPatternSet::Build()
+{
+    FSegments.clear();
+    FSegmentPatterns.clear();
+
+    // Sweep over the range boundaries: +1 for a pattern where one of its
+    // ranges starts, -1 right after it ends. Ranges of one pattern may
+    // touch or overlap (wildcards, '~'), so a pattern stays active while
+    // any of its ranges does, whatever the order of events at a key.
+    std::map<arith_uint256, std::vector<std::pair<uint32_t, int> > > events;
+    for (uint32_t k = 0; k < FPatterns.size(); k++) {
+        for (const auto &range : FPatterns[k].Ranges()) {
+            events[fromBytes(range.first, VanityPattern::HASH160_SIZE)].push_back(std::make_pair(k, 1));
+            events[fromBytes(range.last, VanityPattern::HASH160_SIZE) + 1].push_back(std::make_pair(k, -1));
+        }
+    }
+
+    std::map<uint32_t, int> active;     // pattern -> ranges covering the key
+    for (auto it = events.begin(); it != events.end(); ++it) {
+        for (const auto &event : it->second) {
+            if ((active[event.first] += event.second) == 0)
+                active.erase(event.first);
+        }
+
+        auto next = it;
+        if (active.empty() || ++next == events.end())
+            continue;
+
+        Segment segment;
+        toBytes(it->first, segment.first, VanityPattern::HASH160_SIZE);
+        toBytes(next->first - 1, segment.last, VanityPattern::HASH160_SIZE);
+        segment.begin = FSegmentPatterns.size();
+        for (const auto &pattern : active)
+            FSegmentPatterns.push_back(pattern.first);
+        segment.end = FSegmentPatterns.size();
+        FSegments.push_back(segment);
+    }
+
+    // FIndex[v] is the first segment that reaches into bucket v
+    const size_t buckets = size_t(1) << RADIX_BITS;
+    FIndex.assign(buckets + 1, FSegments.size());
+    size_t segment = 0;
+    for (size_t bucket = 0; bucket < buckets; bucket++) {
+        while (segment < FSegments.size() && radixOf(FSegments[segment].last) < bucket)
+            segment++;
+        FIndex[bucket] = segment;
+    }
+}
+
+size_t cosmyc::VanityPatternSet::SelfCheck(size_t samples) const
+{
+    const arith_uint256 end = arith_uint256(1) << (8 * VanityPattern::HASH160_SIZE);
+
+    std::vector<arith_uint256> points;
+    std::vector<std::pair<arith_uint256, arith_uint256> > ranges;
+    for (const auto &pattern : FPatterns) {
+        for (const auto &range : pattern.Ranges()) {
+            const arith_uint256 first = fromBytes(range.first, VanityPattern::HASH160_SIZE);
+            const arith_uint256 last = fromBytes(range.last, VanityPattern::HASH160_SIZE);
+            ranges.push_back(std::make_pair(first, last));
+
+            points.push_back(first);
+            points.push_back(last);
+            if (first != 0)
+                points.push_back(first - 1);
+            if (last + 1 != end)
+                points.push_back(last + 1);
+        }
+    }
+
+    // Fixed seed, a failure can be reproduced
+    std::mt19937_64 random(0x5eed);
+    auto draw = [&random, &end]() {
+        arith_uint256 value = 0;
+        for (unsigned k = 0; k < 3; k++) {
+            value <<= 64;
+            value += random();
+        }
+        return value - (value / end) * end;
+    };
+
+    for (size_t k = 0; k < samples; k++) {
+        if (ranges.empty() || k % 4 == 0) {
+            points.push_back(draw());
+            continue;
+        }
+
+        const auto &range = ranges[random() % ranges.size()];
+        const arith_uint256 width = range.second - range.first + 1;
+        const arith_uint256 value = draw();
+        points.push_back(range.first + (value - (value / width) * width));
+    }
+
+    size_t              mismatches = 0;
+    unsigned char       hash160[VanityPattern::HASH160_SIZE];
+    std::vector<size_t> found, expected;
+
+    for (const auto &point : points) {
+        toBytes(point, hash160, sizeof(hash160));
+
+        found.clear();
+        Match(hash160, found);
+        std::sort(found.begin(), found.end());
+
+        expected.clear();
+        for (size_t k = 0; k < FPatterns.size(); k++) {
+            if (FPatterns[k].Match(hash160))
+                expected.push_back(k);
+        }
+
+        if (found != expected)
+            mismatches++;
+    }
+    return mismatches;
+}
+
+size_t cosmyc::VanityPatternSet::Size() const
+{
+    return FPatterns.size();
+}
+
+const cosmyc::VanityPattern &cosmyc::VanityPatternSet::Pattern(size_t index) const
+{
+    return FPatterns[index];
+}
+
+bool cosmyc::VanityPatternSet::Match(
+    const   unsigned char       *hash160,
+            std::vector<size_t> &matches) const
+{
+    if (FSegments.empty())
+        return false;
+
+    // The bucket holds its own segments plus possibly the first segment
+    // of the next bucket, when that one starts inside this bucket
+    const unsigned  bucket = radixOf(hash160);
+    const size_t    begin = FIndex[bucket];
+    const size_t    end = std::min<size_t>(FIndex[bucket + 1] + 1, FSegments.size());
+
+    // Last segment starting at or before hash160
+    size_t low = begin, high = end;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (memcmp(FSegments[middle].first, hash160, VanityPattern::HASH160_SIZE) <= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == begin)
+        return false;
+
+    const Segment &segment = FSegments[low - 1];
+    if (memcmp(hash160, segment.last, VanityPattern::HASH160_SIZE) > 0)
+        return false;
+
+    // Exact per-pattern check, it only differs on range edges
+    bool found = false;
+    for (uint32_t k = segment.begin; k < segment.end; k++) {
+        if (FPatterns[FSegmentPatterns[k]].Match(hash160)) {
+            matches.push_back(FSegmentPatterns[k]);
+            found = true;
+        }
+    }
+    return found;
+}
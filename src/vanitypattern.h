@@ -0,0 +1,183 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cosmyc {
+
+
+/// Address kinds a key can be searched for
+typedef enum _ADDRESS_TYPE
+{
+    atP2PKH = 0,        // base58 "1..."
+    atP2WPKH,           // bech32 "bc1q...", compressed keys only
+    atP2TR              // bech32m "bc1p...", untweaked x-only key, no hashing
+} ADDRESS_TYPE;
+
+/// Inclusive range of big-endian hash160 values (for P2TR: of the first
+/// 20 bytes of the x-only key)
+struct Hash160Range
+{
+    unsigned char first[20];
+    unsigned char last[20];
+};
+
+/// A base58 prefix of a P2PKH address compiled into hash160 ranges.
+///
+/// The address is base58 of the 25-byte payload 0x00 | hash160 | checksum.
+/// Every leading zero byte becomes a '1', the rest is the base58 form of
+/// the payload as a number N = hash160 * 2^32 + checksum. The numbers whose
+/// base58 form starts with a given prefix form one contiguous range per
+/// possible digit count, so a pattern turns into a few hash160 ranges.
+/// Candidates are then tested with 20-byte compares instead of a checksum
+/// and a base58 encoding per key.
+///
+/// A '?' stands for any one character, and a leading '~' makes a base58
+/// pattern case-insensitive ("~1love" takes "1LoVe" as well). Both turn a
+/// position into a set of digits; every run of consecutive digits in it
+/// splits the ranges once more, so "~1abc" needs 8 ranges per digit
+/// count. A pattern that would need more than a few thousand ranges is
+/// compiled for its longest prefix that does not, and a candidate inside
+/// those ranges has its address checked digit by digit. Either way a
+/// candidate costs one table lookup, and the complexity is the exact
+/// share of all payloads the ranges cover, leading digits included.
+///
+/// A bech32 P2WPKH prefix "bc1q..." is simpler still: every character
+/// after "bc1q" is the next 5 bits of the hash160, so the prefix is a
+/// mask/value pair, i.e. a single range, and no checksum is involved.
+/// A wildcard only clears mask bits; the range then covers the characters
+/// before the first one.
+///
+/// A bech32m P2TR prefix "bc1p..." works the same way on the x-only
+/// public key itself. The output key is the searched key as is, not
+/// tweaked as in BIP86 wallets: it is spent by a key-path signature
+/// with the private key found, and a candidate needs no hashing at all.
+/// Its first 20 bytes stand in for the hash160, which limits a pattern
+/// to 32 characters after "bc1p".
+class VanityPattern
+{
+public:
+    static const size_t HASH160_SIZE = 20;
+
+    VanityPattern();
+
+    /// Returns false if pattern is not a valid P2PKH, P2WPKH or P2TR
+    /// (mainnet) prefix
+    bool Compile(const std::string &pattern);
+
+    const std::string &Pattern() const;
+    ADDRESS_TYPE Type() const;
+
+    /// Expected number of addresses to try before one matches
+    double Complexity() const;
+
+    const std::vector<Hash160Range> &Ranges() const;
+
+    /// Exact test: true if the address of hash160 (P2TR: of the x-only
+    /// key starting with these 20 bytes) starts with the pattern.
+    /// Only a hash160 on the very edge of a range, where the checksum
+    /// decides, pays for a full address encoding.
+    bool Match(const unsigned char *hash160) const;
+
+    /// Address in the form of the pattern of key: a hash160, or the
+    /// 32-byte x-only public key for P2TR
+    std::string Address(const unsigned char *key) const;
+
+    static bool IsValid(const std::string &pattern);
+
+    /// atP2TR for "bc1p..." patterns, atP2WPKH for other "bc1..."
+    /// patterns, atP2PKH otherwise
+    static ADDRESS_TYPE TypeOf(const std::string &pattern);
+
+    /// Expected number of keys to try before one matches pattern,
+    /// infinity for an invalid pattern, see Vanity::PatternComplexity
+    static double Complexity(const std::string &pattern);
+
+    /// Reward per unit of work of a bounty for a pattern of complexity,
+    /// see Vanity::PatternLavishness
+    static double Lavishness(uint64_t bounty, double complexity);
+
+    /// Base58Check P2PKH address of hash160
+    static std::string EncodeAddress(const unsigned char *hash160);
+
+    /// Bech32 P2WPKH (witness version 0) address of hash160
+    static std::string EncodeSegwitAddress(const unsigned char *hash160);
+
+    /// Bech32m P2TR (witness version 1) address of a 32-byte x-only key
+    static std::string EncodeTaprootAddress(const unsigned char *xonly);
+
+private:
+    bool CompileSegwit();
+
+    /// hash160 & FMask == FValue, for bech32 patterns with wildcards
+    bool Masked(const unsigned char *hash160) const;
+
+    /// Digit by digit test of a base58 address against FSets
+    bool Accepts(const std::string &address) const;
+
+    std::string                 FPattern;
+    ADDRESS_TYPE                FType;
+    std::vector<Hash160Range>   FRanges;
+    std::vector<uint64_t>       FSets;      // base58 digits allowed per position
+    bool                        FExact;     // the ranges alone decide
+    double                      FComplexity;
+    unsigned char               FValue[HASH160_SIZE];
+    unsigned char               FMask[HASH160_SIZE];
+};
+
+/// Many prefixes compiled into one table, so every candidate is checked
+/// against all of them at once.
+///
+/// The ranges of all patterns are cut into sorted, disjoint hash160
+/// segments, each listing the patterns that cover it. A lookup reads a
+/// 2^16 entry radix index on the first two bytes of the hash160 and then
+/// binary searches the few segments of that bucket.
+class VanityPatternSet
+{
+public:
+    VanityPatternSet();
+
+    /// Returns false (and leaves the set unchanged) for an invalid pattern
+    bool Add(const std::string &pattern);
+    void Clear();
+
+    /// Builds the lookup table, call it after the last Add()
+    void Build();
+
+    size_t Size() const;
+    const VanityPattern &Pattern(size_t index) const;
+
+    /// Appends the indices of all patterns matching hash160 to matches.
+    /// Returns true if there was at least one.
+    bool Match(
+        const   unsigned char       *hash160,
+                std::vector<size_t> &matches) const;
+
+    /// Brute-force check of the table against Pattern(k).Match() for
+    /// every pattern: on both sides of the edges of every range and on
+    /// samples random hash160s, most of them inside some range. Returns
+    /// the number of hash160s the two disagree on, 0 for a sound table.
+    size_t SelfCheck(size_t samples) const;
+
+private:
+    static const unsigned RADIX_BITS = 16;
+
+    struct Segment
+    {
+        unsigned char   first[20];
+        unsigned char   last[20];
+        uint32_t        begin;      // into FSegmentPatterns
+        uint32_t        end;
+    };
+
+    std::vector<VanityPattern>  FPatterns;
+    std::vector<Segment>        FSegments;
+    std::vector<uint32_t>       FSegmentPatterns;
+    std::vector<uint32_t>       FIndex;     // first segment per radix bucket
+};
+
+
+} // namespace cosmyc
@@ -0,0 +1,1183 @@
+#include "vanitypool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "crypto/hash160.h"
+#include "keywalker.h"
+#include "random.h"
+#include "utilstrencodings.h"
+#include "vanitypattern.h"
+
+/*
+ * Protocol
+ *
+ * Every message is one frame: a 4-byte big-endian length followed by that
+ * many bytes of text, words separated by single spaces.
+ *
+ * worker -> coordinator
+ *   HELLO <version> <threads> <name>
+ *   HEARTBEAT <range> <keys> <keys per second>
+ *   MATCH <range> <pattern> <address> <private key> <public key> <split mode>
+ *   DONE <range>
+ *   REJECT <range>
+ *
+ * coordinator -> worker
+ *   JOB <formats> <symmetries> <split mode> <split key|-> <pattern>...
+ *   RANGE <range> <start> <points>
+ *   STOP
+ *
+ * The coordinator answers HELLO with JOB and a RANGE, and every DONE with
+ * the next RANGE. Start is a hex private key, points a decimal count. A
+ * worker without a range just waits; one that sends nothing for
+ * HEARTBEAT_TIMEOUT seconds is dropped and its range handed out again.
+ * A worker that cannot run the job answers its first RANGE with REJECT and
+ * disconnects, the range goes to the next worker. The coordinator derives
+ * the public key and address of every MATCH again and drops a worker that
+ * sends one that is false.
+ */
+
+namespace {
+
+const int       PROTOCOL_VERSION = 1;
+
+/// Upper bound of a frame, a JOB with some ten thousand patterns
+const uint32_t  MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+/// Poll timeout, how quickly Stop() takes effect
+const int       POLL_INTERVAL = 1000;   // milliseconds
+
+double secondsSince(const std::chrono::steady_clock::time_point &from)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+}
+
+std::vector<std::string> splitWords(const std::string &message)
+{
+    std::vector<std::string>    words;
+    std::istringstream          ss(message);
+    std::string                 word;
+
+    while (ss >> word)
+        words.push_back(word);
+    return words;
+}
+
+bool parseUInt64(const std::string &text, uint64_t &value)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+
+    errno = 0;
+    value = strtoull(text.c_str(), nullptr, 10);
+    return errno == 0;
+}
+
+/// Takes the first complete frame off buffer. Returns false if there is
+/// none yet; sets bad for a frame that is too large.
+bool nextFrame(std::string &buffer, std::string &message, bool &bad)
+{
+    bad = false;
+    if (buffer.size() < 4)
+        return false;
+
+    const unsigned char *header = reinterpret_cast<const unsigned char *>(buffer.data());
+    const uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+                        | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+
+    if (size > MAX_FRAME_SIZE) {
+        bad = true;
+        return false;
+    }
+    if (buffer.size() < 4 + size_t(size))
+        return false;
+
+    message.assign(buffer, 4, size);
+    buffer.erase(0, 4 + size_t(size));
+    return true;
+}
+
+/// Random private key below 2^255, far enough from the group order
+/// that base + any number of ranges never wraps. Every key the job finds
+/// follows from it, so it comes from the OS generator.
+arith_uint256 randomBase()
+{
+    unsigned char   bytes[32];
+    arith_uint256   base;
+
+    do {
+        GetStrongRandBytes(bytes, sizeof(bytes));
+        base = 0;
+        for (size_t k = 0; k < sizeof(bytes); k++) {
+            base <<= 8;
+            base += bytes[k];
+        }
+        base >>= 1;
+    } while (base == 0);
+
+    memset(bytes, 0, sizeof(bytes));
+    return base;
+}
+
+#ifndef _WIN32
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/// Sends a whole frame, false if the connection is gone
+bool sendFrame(int fd, const std::string &message)
+{
+    std::string frame(4, '\0');
+    frame[0] = char((message.size() >> 24) & 0xFF);
+    frame[1] = char((message.size() >> 16) & 0xFF);
+    frame[2] = char((message.size() >> 8) & 0xFF);
+    frame[3] = char(message.size() & 0xFF);
+    frame += message;
+
+    size_t sent = 0;
+    while (sent < frame.size()) {
+        ssize_t count = send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        sent += size_t(count);
+    }
+    return true;
+}
+
+/// Appends what is available on fd to buffer, false on EOF or error
+bool receive(int fd, std::string &buffer)
+{
+    char data[4096];
+
+    ssize_t count;
+    do {
+        count = recv(fd, data, sizeof(data), 0);
+    } while (count < 0 && errno == EINTR);
+
+    if (count <= 0)
+        return false;
+
+    buffer.append(data, size_t(count));
+    return true;
+}
+
+/// Waits up to POLL_INTERVAL for fd to become readable
+bool readable(int fd)
+{
+    pollfd entry;
+    entry.fd = fd;
+    entry.events = POLLIN;
+    entry.revents = 0;
+
+    return poll(&entry, 1, POLL_INTERVAL) > 0;
+}
+
+/// A send to a worker that stopped reading fails instead of blocking
+/// the coordinator
+void setSendTimeout(int fd)
+{
+    timeval timeout;
+    timeout.tv_sec = 10;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+/// Listening (bind) or connected socket for "tcp:host:port" or
+/// "unix:path". An empty or "*" host listens on all interfaces.
+int openSocket(const std::string &address, bool bind, std::string *unixPath)
+{
+    if (address.compare(0, 5, "unix:") == 0) {
+        const std::string path = address.substr(5);
+
+        sockaddr_un name;
+        memset(&name, 0, sizeof(name));
+        if (path.empty() || path.size() >= sizeof(name.sun_path))
+            return -1;
+        name.sun_family = AF_UNIX;
+        memcpy(name.sun_path, path.c_str(), path.size());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+
+        if (bind) {
+            // A socket file left behind by a previous run
+            unlink(path.c_str());
+            if (::bind(fd, reinterpret_cast<sockaddr *>(&name), sizeof(name)) != 0
+                    || listen(fd, 64) != 0) {
+                close(fd);
+                return -1;
+            }
+            if (unixPath)
+                *unixPath = path;
+        } else if (connect(fd, reinterpret_cast<sockaddr *>(&name), sizeof(name)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    std::string hostPort = address.compare(0, 4, "tcp:") == 0 ? address.substr(4) : address;
+    const size_t colon = hostPort.rfind(':');
+    if (colon == std::string::npos)
+        return -1;
+
+    std::string host = hostPort.substr(0, colon);
+    const std::string port = hostPort.substr(colon + 1);
+    if (host.size() >= 2 && host[0] == '[' && host[host.size() - 1] == ']')
+        host = host.substr(1, host.size() - 2);     // [IPv6]
+    if (host == "*")
+        host.clear();
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (bind)
+        hints.ai_flags = AI_PASSIVE;
+
+    addrinfo *found = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0)
+        return -1;
+
+    int fd = -1;
+    for (addrinfo *entry = found; entry != nullptr && fd < 0; entry = entry->ai_next) {
+        fd = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        bool ok;
+        if (bind) {
+            int yes = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+            ok = ::bind(fd, entry->ai_addr, entry->ai_addrlen) == 0 && listen(fd, 64) == 0;
+        } else {
+            ok = connect(fd, entry->ai_addr, entry->ai_addrlen) == 0;
+            if (ok) {
+                // Heartbeats and matches are tiny, send them right away
+                int yes = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+            }
+        }
+
+        if (!ok) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(found);
+    return fd;
+}
+
+#endif // _WIN32
+
+/// Coordinator of the command line mode, for the SIGINT handler
+std::atomic<cosmyc::VanityCoordinator *>    runningCoordinator(nullptr);
+std::atomic<cosmyc::VanityPoolWorker *>     runningWorker(nullptr);
+
+void interrupted(int)
+{
+    if (cosmyc::VanityCoordinator *coordinator = runningCoordinator.load())
+        coordinator->Stop();
+    if (cosmyc::VanityPoolWorker *worker = runningWorker.load())
+        worker->Stop();
+}
+
+void printUsage(const char *program)
+{
+    std::cerr
+        << "usage: " << program << " --coordinator <address> [options] <pattern>...\n"
+        << "       " << program << " --worker <address> [--threads <n>] [--name <name>]\n"
+        << "                [--placement none|compact|spread|physical]\n"
+        << "\n"
+        << "address is tcp:<host>:<port> or unix:<path>\n"
+        << "\n"
+        << "coordinator options:\n"
+        << "  --compressed          test compressed keys only\n"
+        << "  --both                test compressed and uncompressed keys\n"
+        << "  --symmetries          also test negations and endomorphism images\n"
+        << "  --split-key <hex>     customer public key of a split-key search\n"
+        << "  --multiplicative      multiplicative instead of additive split key\n"
+        << "  --all-matches         keep searching after every pattern matched\n"
+        << "  --range <points>      points per range (default 2^28)\n"
+        << "  --ranges <count>      end after that many ranges (default no limit)\n"
+        << "  --status <seconds>    status line interval (default 10, 0 for none)\n";
+}
+
+void printMatch(const cosmyc::VanityMatch &match)
+{
+    std::cout << "match " << match.pattern << " " << match.address
+              << (match.splitKey == cosmyc::skNone ? " private " : " partial ")
+              << match.privateKey << " " << match.publicKey << std::endl;
+}
+
+} // namespace
+
+
+cosmyc::VanityJob::VanityJob()
+    : formats(kfUncompressed)
+    , symmetries(false)
+    , splitKeyMode(skNone)
+    , stopOnMatch(true)
+    , rangeLength(uint64_t(1) << 28)
+    , maxRanges(0)
+{
+}
+
+
+cosmyc::VanityCoordinator::VanityCoordinator()
+    : FListener(-1)
+    , FPatternCount(0)
+    , FNextRange(0)
+    , FRangesDone(0)
+    , FReassigned(0)
+    , FVerbose(0)
+    , FStop(false)
+{
+}
+
+cosmyc::VanityCoordinator::~VanityCoordinator()
+{
+#ifndef _WIN32
+    for (const auto &connection : FConnections)
+        close(connection.fd);
+    if (FListener >= 0)
+        close(FListener);
+    if (!FUnixPath.empty())
+        unlink(FUnixPath.c_str());
+#endif
+}
+
+bool cosmyc::VanityCoordinator::Listen(const std::string &address)
+{
+#ifdef _WIN32
+    (void)address;
+    return false;
+#else
+    if (FListener >= 0)
+        return false;
+
+    FListener = openSocket(address, true, &FUnixPath);
+    return FListener >= 0;
+#endif
+}
+
+void cosmyc::VanityCoordinator::Stop()
+{
+    FStop.store(true);
+}
+
+void cosmyc::VanityCoordinator::SetVerbose(unsigned interval)
+{
+    FVerbose = interval;
+}
+
+bool cosmyc::VanityCoordinator::Run(const VanityJob &job)
+{
+#ifdef _WIN32
+    (void)job;
+    return false;
+#else
+    if (FListener < 0 || job.rangeLength == 0 || job.patterns.empty() || (job.formats & kfBoth) == 0)
+        return false;
+
+    // Workers would only fail on the job later. bc1q addresses only hash
+    // compressed keys, see VanitySearch::Resume().
+    VanityPatternSet patterns;
+    for (const auto &pattern : job.patterns) {
+        const bool unreachable = VanityPattern::TypeOf(pattern) == atP2WPKH
+                && (job.formats & kfCompressed) == 0;
+        if (unreachable || !patterns.Add(pattern))
+            return false;
+    }
+
+    if (job.splitKeyMode != skNone) {
+        KeyWalker walker(KeyWalker::MIN_BATCH_SIZE);
+        if (job.splitKey.empty() || !walker.SetOffset(&job.splitKey[0], job.splitKey.size()))
+            return false;
+    }
+
+    FJob = job;
+    FPatternCount = std::set<std::string>(job.patterns.begin(), job.patterns.end()).size();
+    FBase = randomBase();
+    FNextRange = 0;
+    FRangesDone = 0;
+    FReassigned = 0;
+    FRequeued.clear();
+    FSeen.clear();
+    FMatched.clear();
+    FMatches.clear();
+    FStop.store(false);
+    FStarted = std::chrono::steady_clock::now();
+
+    std::ostringstream ss;
+    ss << "JOB " << int(job.formats) << " " << (job.symmetries ? 1 : 0)
+       << " " << int(job.splitKeyMode) << " "
+       << (job.splitKey.empty() ? std::string("-") : HexStr(job.splitKey));
+    for (const auto &pattern : job.patterns)
+        ss << " " << pattern;
+    FJobMessage = ss.str();
+
+    auto lastStatus = std::chrono::steady_clock::now();
+
+    while (!FStop.load() && !Finished()) {
+        std::vector<pollfd> entries(1 + FConnections.size());
+        entries[0].fd = FListener;
+        entries[0].events = POLLIN;
+        entries[0].revents = 0;
+        for (size_t k = 0; k < FConnections.size(); k++) {
+            entries[1 + k].fd = FConnections[k].fd;
+            entries[1 + k].events = POLLIN;
+            entries[1 + k].revents = 0;
+        }
+
+        if (poll(&entries[0], entries.size(), POLL_INTERVAL) < 0 && errno != EINTR)
+            break;
+
+        // Only the connections polled above, Accept() appends new ones
+        const size_t polled = entries.size() - 1;
+        std::vector<bool> lost(polled, false);
+
+        for (size_t k = 0; k < polled; k++) {
+            Connection &connection = FConnections[k];
+
+            if (entries[1 + k].revents != 0 && !Receive(connection))
+                lost[k] = true;
+            else if (secondsSince(connection.lastSeen) > HEARTBEAT_TIMEOUT)
+                lost[k] = true;
+        }
+
+        if (entries[0].revents & POLLIN)
+            Accept();
+
+        for (size_t k = polled; k-- > 0; ) {
+            if (!lost[k])
+                continue;
+
+            Release(FConnections[k]);
+            close(FConnections[k].fd);
+            FConnections.erase(FConnections.begin() + k);
+        }
+
+        // Ranges of lost workers go to whoever is idle. A failed send
+        // times the connection out on the next round.
+        for (auto &connection : FConnections) {
+            if (connection.greeted && !connection.busy && !Assign(connection))
+                connection.lastSeen = std::chrono::steady_clock::time_point();
+        }
+
+        if (FVerbose != 0 && secondsSince(lastStatus) >= FVerbose) {
+            PrintStatus();
+            lastStatus = std::chrono::steady_clock::now();
+        }
+    }
+
+    Broadcast("STOP");
+    for (const auto &connection : FConnections)
+        close(connection.fd);
+    FConnections.clear();
+
+    if (FVerbose != 0)
+        PrintStatus();
+
+    return true;
+#endif
+}
+
+void cosmyc::VanityCoordinator::Accept()
+{
+#ifndef _WIN32
+    int fd = accept(FListener, nullptr, nullptr);
+    if (fd < 0)
+        return;
+
+    setSendTimeout(fd);
+
+    Connection connection;
+    connection.fd = fd;
+    connection.threads = 0;
+    connection.greeted = false;
+    connection.busy = false;
+    connection.range = 0;
+    connection.keys = 0;
+    connection.keysPerSecond = 0;
+    connection.lastSeen = std::chrono::steady_clock::now();
+    FConnections.push_back(connection);
+#endif
+}
+
+bool cosmyc::VanityCoordinator::Receive(Connection &connection)
+{
+#ifdef _WIN32
+    (void)connection;
+    return false;
+#else
+    if (!receive(connection.fd, connection.input))
+        return false;
+
+    std::string message;
+    bool        bad;
+    while (nextFrame(connection.input, message, bad)) {
+        if (!Handle(connection, message))
+            return false;
+    }
+    return !bad;
+#endif
+}
+
+bool cosmyc::VanityCoordinator::Handle(Connection &connection, const std::string &message)
+{
+    const std::vector<std::string> words = splitWords(message);
+    if (words.empty())
+        return false;
+
+    connection.lastSeen = std::chrono::steady_clock::now();
+
+    if (words[0] == "HELLO") {
+        uint64_t version = 0, threads = 0;
+        if (connection.greeted || words.size() < 4
+                || !parseUInt64(words[1], version) || version != PROTOCOL_VERSION
+                || !parseUInt64(words[2], threads))
+            return false;
+
+        connection.greeted = true;
+        connection.name = words[3];
+        connection.threads = unsigned(threads);
+
+#ifndef _WIN32
+        if (!sendFrame(connection.fd, FJobMessage))
+            return false;
+#endif
+        return Assign(connection);
+    }
+
+    // Everything else is about the worker's current range
+    uint64_t range = 0;
+    if (!connection.greeted || words.size() < 2 || !parseUInt64(words[1], range))
+        return false;
+
+    if (words[0] == "HEARTBEAT") {
+        uint64_t keys = 0;
+        if (words.size() < 4 || !parseUInt64(words[2], keys))
+            return false;
+
+        // Idle workers send them too, to stay connected
+        if (connection.busy && connection.range == range) {
+            connection.keys = keys;
+            connection.keysPerSecond = atof(words[3].c_str());
+        }
+        return true;
+    }
+
+    if (words[0] == "MATCH") {
+        if (words.size() < 7)
+            return false;
+
+        // Like a late DONE, a match of a range taken away is ignored
+        if (!connection.busy || connection.range != range)
+            return true;
+
+        VanityMatch match;
+        match.pattern = words[2];
+        match.address = words[3];
+        match.privateKey = words[4];
+        match.publicKey = words[5];
+        match.splitKey = SPLIT_KEY_MODE(atoi(words[6].c_str()));
+
+        // One bad worker must not end a job with a made-up key
+        if (!IsGenuine(match)) {
+            if (FVerbose != 0)
+                std::cout << "worker " << connection.name << " sent a false match, dropped" << std::endl;
+            return false;
+        }
+
+        AddMatch(match);
+        return true;
+    }
+
+    if (words[0] == "DONE") {
+        // A late DONE of a range that was already taken away is ignored
+        if (!connection.busy || connection.range != range)
+            return true;
+
+        connection.busy = false;
+        FRangesDone++;
+        return Assign(connection);
+    }
+
+    if (words[0] == "REJECT") {
+        // Dropping the connection hands its range to the next worker
+        if (FVerbose != 0)
+            std::cout << "worker " << connection.name << " cannot run the job, dropped" << std::endl;
+        return false;
+    }
+
+    return false;
+}
+
+bool cosmyc::VanityCoordinator::Assign(Connection &connection)
+{
+    uint64_t range;
+
+    if (!FRequeued.empty()) {
+        range = FRequeued.front();
+        FRequeued.pop_front();
+        FReassigned++;
+    } else if (FJob.maxRanges == 0 || FNextRange < FJob.maxRanges) {
+        range = FNextRange++;
+    } else {
+        return true;    // nothing left, the worker waits for STOP
+    }
+
+    const arith_uint256 start = FBase + arith_uint256(range) * arith_uint256(FJob.rangeLength);
+
+    std::ostringstream ss;
+    ss << "RANGE " << range << " " << start.GetHex() << " " << FJob.rangeLength;
+
+    connection.busy = true;
+    connection.range = range;
+    connection.keys = 0;
+
+#ifdef _WIN32
+    return false;
+#else
+    // A failed send leaves the range on the connection, it is requeued
+    // when the connection is dropped
+    return sendFrame(connection.fd, ss.str());
+#endif
+}
+
+void cosmyc::VanityCoordinator::Release(Connection &connection)
+{
+    if (!connection.busy)
+        return;
+
+    // Nothing of the range is known to be done, so all of it is redone
+    FRequeued.push_back(connection.range);
+    connection.busy = false;
+}
+
+void cosmyc::VanityCoordinator::Broadcast(const std::string &message)
+{
+#ifdef _WIN32
+    (void)message;
+#else
+    for (const auto &connection : FConnections)
+        sendFrame(connection.fd, message);
+#endif
+}
+
+bool cosmyc::VanityCoordinator::IsGenuine(const VanityMatch &match) const
+{
+    if (match.splitKey != FJob.splitKeyMode
+            || std::find(FJob.patterns.begin(), FJob.patterns.end(), match.pattern) == FJob.patterns.end())
+        return false;
+
+    VanityPattern pattern;
+    if (!pattern.Compile(match.pattern))
+        return false;
+
+    const std::vector<unsigned char> seckey = ParseHex(match.privateKey);
+    const std::vector<unsigned char> pubkey = ParseHex(match.publicKey);
+    if (!IsHex(match.privateKey) || seckey.size() != KeyWalker::PRIVATE_KEY_SIZE || !IsHex(match.publicKey))
+        return false;
+
+    // The same key the worker's walker had, offset or base point included
+    KeyWalker walker(KeyWalker::MIN_BATCH_SIZE);
+    if (FJob.splitKeyMode == skAdditive && !walker.SetOffset(&FJob.splitKey[0], FJob.splitKey.size()))
+        return false;
+    if (FJob.splitKeyMode == skMultiplicative && !walker.SetBasePoint(&FJob.splitKey[0], FJob.splitKey.size()))
+        return false;
+    if (!walker.Reset(&seckey[0]))
+        return false;
+
+    // Only formats the job searches, and P2WPKH only for compressed keys
+    const bool compressed = pubkey.size() != 65;
+    bool allowed;
+    if (pattern.Type() == atP2TR)
+        allowed = true;
+    else if (compressed)
+        allowed = (FJob.formats & kfCompressed) != 0;
+    else
+        allowed = (FJob.formats & kfUncompressed) != 0 && pattern.Type() == atP2PKH;
+
+    unsigned char   derived[65];
+    size_t          derivedLen = 0;
+    if (!allowed || !walker.GetPublicKey(derived, &derivedLen, compressed))
+        return false;
+
+    unsigned char   hash160[VanityPattern::HASH160_SIZE];
+    const unsigned char *key;
+
+    if (pattern.Type() == atP2TR) {
+        // x-only, the parity of y does not matter
+        if (pubkey.size() != 32 || memcmp(&pubkey[0], derived + 1, 32) != 0)
+            return false;
+        key = derived + 1;
+    } else {
+        if (pubkey.size() != derivedLen || memcmp(&pubkey[0], derived, derivedLen) != 0)
+            return false;
+        Hash160(derived, derivedLen, hash160);
+        key = hash160;
+    }
+
+    return pattern.Match(key) && pattern.Address(key) == match.address;
+}
+
+void cosmyc::VanityCoordinator::AddMatch(const VanityMatch &match)
+{
+    // Redone ranges report their matches again
+    if (!FSeen.insert(match.pattern + " " + match.address).second)
+        return;
+
+    const bool first = FMatched.insert(match.pattern).second;
+    if (FJob.stopOnMatch && !first)
+        return;
+
+    FMatches.push_back(match);
+    if (FVerbose != 0)
+        printMatch(match);
+}
+
+bool cosmyc::VanityCoordinator::Finished() const
+{
+    if (FJob.stopOnMatch && FMatched.size() >= FPatternCount)
+        return true;
+
+    return FJob.maxRanges != 0 && FRangesDone >= FJob.maxRanges;
+}
+
+void cosmyc::VanityCoordinator::PrintStatus() const
+{
+    const VanityPoolReport report = Report();
+
+    std::cout << "status " << report.workers.size() << " workers, "
+              << uint64_t(report.keysPerSecond) << " keys/s, ranges "
+              << report.rangesDone << " done " << report.rangesIssued << " issued "
+              << report.rangesReassigned << " reassigned, "
+              << report.matches.size() << " matches" << std::endl;
+}
+
+cosmyc::VanityPoolReport cosmyc::VanityCoordinator::Report() const
+{
+    VanityPoolReport report;
+
+    report.rangesIssued = FNextRange;
+    report.rangesDone = FRangesDone;
+    report.rangesReassigned = FReassigned;
+    report.keysPerSecond = 0;
+    report.elapsed = secondsSince(FStarted);
+    report.matches = FMatches;
+
+    for (const auto &connection : FConnections) {
+        if (!connection.greeted)
+            continue;
+
+        VanityPoolWorkerReport worker;
+        worker.name = connection.name;
+        worker.threads = connection.threads;
+        worker.busy = connection.busy;
+        worker.range = connection.range;
+        worker.keys = connection.keys;
+        worker.keysPerSecond = connection.keysPerSecond;
+        worker.lastSeen = secondsSince(connection.lastSeen);
+
+        report.keysPerSecond += worker.keysPerSecond;
+        report.workers.push_back(worker);
+    }
+    return report;
+}
+
+
+cosmyc::VanityPoolWorker::VanityPoolWorker()
+    : FSocket(-1)
+    , FThreads(0)
+    , FPlacement(ppNone)
+    , FHasJob(false)
+    , FRejected(false)
+    , FBusy(false)
+    , FRange(0)
+    , FSent(0)
+    , FStop(false)
+{
+}
+
+cosmyc::VanityPoolWorker::~VanityPoolWorker()
+{
+    FSearch.Stop();
+#ifndef _WIN32
+    if (FSocket >= 0)
+        close(FSocket);
+#endif
+}
+
+bool cosmyc::VanityPoolWorker::Connect(const std::string &address)
+{
+#ifdef _WIN32
+    (void)address;
+    return false;
+#else
+    if (FSocket >= 0)
+        return false;
+
+    FSocket = openSocket(address, false, nullptr);
+    return FSocket >= 0;
+#endif
+}
+
+void cosmyc::VanityPoolWorker::Stop()
+{
+    FStop.store(true);
+}
+
+bool cosmyc::VanityPoolWorker::Rejected() const
+{
+    return FRejected;
+}
+
+void cosmyc::VanityPoolWorker::SetPlacement(PLACEMENT_POLICY policy)
+{
+    FPlacement = policy;
+    FSearch.SetPlacement(policy);
+}
+
+bool cosmyc::VanityPoolWorker::Send(const std::string &message)
+{
+#ifdef _WIN32
+    (void)message;
+    return false;
+#else
+    return sendFrame(FSocket, message);
+#endif
+}
+
+bool cosmyc::VanityPoolWorker::Run(unsigned threads, const std::string &name)
+{
+#ifdef _WIN32
+    (void)threads;
+    (void)name;
+    return false;
+#else
+    if (FSocket < 0)
+        return false;
+
+    FThreads = threads != 0 ? threads : std::max(1u, CpuTopology::Get().DefaultThreads(FPlacement));
+
+    // The name is one word of the protocol
+    std::string hostName = name;
+    if (hostName.empty()) {
+        char buffer[256] = "";
+        gethostname(buffer, sizeof(buffer) - 1);
+        std::ostringstream ss;
+        ss << buffer << "-" << getpid();
+        hostName = ss.str();
+    }
+    std::replace_if(hostName.begin(), hostName.end(), [](char c) { return c <= ' '; }, '_');
+
+    std::ostringstream hello;
+    hello << "HELLO " << PROTOCOL_VERSION << " " << FThreads << " " << hostName;
+    if (!Send(hello.str()))
+        return false;
+
+    std::string input;
+    auto        lastHeartbeat = std::chrono::steady_clock::now();
+
+    while (!FStop.load()) {
+        if (readable(FSocket)) {
+            if (!receive(FSocket, input))
+                break;
+
+            std::string message;
+            bool        bad;
+            while (nextFrame(input, message, bad)) {
+                const std::vector<std::string> words = splitWords(message);
+
+                if (words.empty())
+                    continue;
+
+                if (words[0] == "STOP") {
+                    FSearch.Stop();
+                    return true;
+                }
+
+                if (words[0] == "JOB") {
+                    if (words.size() < 6)
+                        return false;
+
+                    FJob = VanityJob();
+                    FJob.formats = KEY_FORMATS(atoi(words[1].c_str()));
+                    FJob.symmetries = atoi(words[2].c_str()) != 0;
+                    FJob.splitKeyMode = SPLIT_KEY_MODE(atoi(words[3].c_str()));
+                    if (words[4] != "-")
+                        FJob.splitKey = ParseHex(words[4]);
+                    FJob.patterns.assign(words.begin() + 5, words.end());
+                    FHasJob = true;
+                } else if (words[0] == "RANGE") {
+                    // Tell the coordinator rather than just going away, it
+                    // would hand the range to the next worker only after
+                    // the heartbeat timeout
+                    if (!StartRange(message)) {
+                        std::ostringstream ss;
+                        ss << "REJECT " << (words.size() > 1 ? words[1] : std::string("0"));
+                        Send(ss.str());
+                        FRejected = true;
+                        FSearch.Stop();
+                        return false;
+                    }
+                    lastHeartbeat = std::chrono::steady_clock::now();
+                }
+            }
+            if (bad)
+                break;
+        }
+
+        // Matches go out as soon as they are found, progress with the
+        // heartbeat, the end of the range right away
+        const bool finished = FBusy && !FSearch.IsRunning();
+        const bool heartbeat = secondsSince(lastHeartbeat) >= HEARTBEAT_INTERVAL;
+
+        if (!SendProgress(finished, heartbeat))
+            break;
+        if (heartbeat)
+            lastHeartbeat = std::chrono::steady_clock::now();
+    }
+
+    FSearch.Stop();
+    return false;
+#endif
+}
+
+bool cosmyc::VanityPoolWorker::StartRange(const std::string &message)
+{
+    const std::vector<std::string> words = splitWords(message);
+
+    uint64_t range = 0, points = 0;
+    if (!FHasJob || words.size() < 4 || !parseUInt64(words[1], range) || !parseUInt64(words[3], points))
+        return false;
+
+    arith_uint256 start;
+    start.SetHex(words[2]);
+
+    // The range may still be in flight if the coordinator reassigned it
+    FSearch.Stop();
+
+    VanityCheckpoint checkpoint;
+    checkpoint.patterns = FJob.patterns;
+    checkpoint.formats = FJob.formats;
+    checkpoint.stopOnMatch = false;     // the coordinator decides when to stop
+    checkpoint.batchSize = KeyWalker::DEFAULT_BATCH_SIZE;
+    checkpoint.symmetries = FJob.symmetries;
+    checkpoint.splitKeyMode = FJob.splitKeyMode;
+    checkpoint.splitKey = FJob.splitKey;
+    checkpoint.hits.assign(FJob.patterns.size(), 0);
+
+    // Every thread walks its own consecutive part of the range
+    const uint64_t threads = std::max<uint64_t>(1, std::min<uint64_t>(FThreads, points));
+    const uint64_t share = points / threads;
+    for (uint64_t k = 0; k < threads; k++) {
+        VanityCheckpoint::Worker worker;
+        worker.start = start + arith_uint256(k * share);
+        worker.steps = 0;
+        worker.limit = k + 1 < threads ? share : points - k * share;
+        worker.keys = 0;
+        worker.hash160s = 0;
+        worker.matches = 0;
+        checkpoint.workers.push_back(worker);
+    }
+
+    if (!FSearch.Resume(checkpoint))
+        return false;
+
+    FBusy = true;
+    FRange = range;
+    FSent = 0;
+    return true;
+}
+
+bool cosmyc::VanityPoolWorker::SendProgress(bool finished, bool heartbeat)
+{
+    if (!FBusy) {
+        if (!heartbeat)
+            return true;
+
+        std::ostringstream ss;
+        ss << "HEARTBEAT " << FRange << " 0 0";
+        return Send(ss.str());
+    }
+
+    const VanityReport report = FSearch.Report();
+
+    for (; FSent < report.matches.size(); FSent++) {
+        const VanityMatch &match = report.matches[FSent];
+
+        std::ostringstream ss;
+        ss << "MATCH " << FRange << " " << match.pattern << " " << match.address
+           << " " << match.privateKey << " " << match.publicKey << " " << int(match.splitKey);
+        if (!Send(ss.str()))
+            return false;
+    }
+
+    if (finished) {
+        FBusy = false;
+
+        std::ostringstream ss;
+        ss << "DONE " << FRange;
+        return Send(ss.str());
+    }
+
+    if (heartbeat) {
+        std::ostringstream ss;
+        ss << "HEARTBEAT " << FRange << " " << report.keysTested << " " << uint64_t(report.keysPerSecond);
+        return Send(ss.str());
+    }
+    return true;
+}
+
+
+int cosmyc::VanityPoolMain(int argc, char *argv[])
+{
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    const std::string mode = argv[1];
+    const std::string address = argv[2];
+
+    // A worker only ever sees the coordinator going away as a failed send
+    signal(SIGINT, interrupted);
+    signal(SIGTERM, interrupted);
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if (mode == "--worker") {
+        unsigned            threads = 0;
+        std::string         name;
+        PLACEMENT_POLICY    placement = ppNone;
+
+        for (int k = 3; k < argc; k++) {
+            const std::string option = argv[k];
+            if (option == "--threads" && k + 1 < argc) {
+                threads = unsigned(atoi(argv[++k]));
+            } else if (option == "--name" && k + 1 < argc) {
+                name = argv[++k];
+            } else if (option == "--placement" && k + 1 < argc && CpuTopology::ParsePolicy(argv[k + 1], placement)) {
+                k++;
+            } else {
+                printUsage(argv[0]);
+                return 2;
+            }
+        }
+
+        VanityPoolWorker worker;
+        worker.SetPlacement(placement);
+        if (!worker.Connect(address)) {
+            std::cerr << "cannot connect to " << address << std::endl;
+            return 1;
+        }
+
+        runningWorker.store(&worker);
+        const bool done = worker.Run(threads, name);
+        runningWorker.store(nullptr);
+
+        if (worker.Rejected())
+            std::cerr << "cannot run the job of the coordinator" << std::endl;
+        else if (!done)
+            std::cerr << "connection to the coordinator lost" << std::endl;
+        return done ? 0 : 1;
+    }
+
+    if (mode != "--coordinator") {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    VanityJob   job;
+    unsigned    status = 10;
+
+    for (int k = 3; k < argc; k++) {
+        const std::string option = argv[k];
+        const bool hasValue = k + 1 < argc;
+
+        if (option == "--compressed") {
+            job.formats = kfCompressed;
+        } else if (option == "--both") {
+            job.formats = kfBoth;
+        } else if (option == "--symmetries") {
+            job.symmetries = true;
+        } else if (option == "--split-key" && hasValue) {
+            job.splitKey = ParseHex(argv[++k]);
+            if (job.splitKeyMode == skNone)
+                job.splitKeyMode = skAdditive;
+        } else if (option == "--multiplicative") {
+            job.splitKeyMode = skMultiplicative;
+        } else if (option == "--all-matches") {
+            job.stopOnMatch = false;
+        } else if (option == "--range" && hasValue) {
+            if (!parseUInt64(argv[++k], job.rangeLength) || job.rangeLength == 0) {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } else if (option == "--ranges" && hasValue) {
+            if (!parseUInt64(argv[++k], job.maxRanges)) {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } else if (option == "--status" && hasValue) {
+            status = unsigned(atoi(argv[++k]));
+        } else if (option.compare(0, 2, "--") == 0) {
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            job.patterns.push_back(option);
+        }
+    }
+
+    if (job.splitKeyMode == skMultiplicative && job.splitKey.empty()) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    VanityCoordinator coordinator;
+    if (!coordinator.Listen(address)) {
+        std::cerr << "cannot listen on " << address << std::endl;
+        return 1;
+    }
+
+    // Matches are the whole point, print them even without status lines
+    coordinator.SetVerbose(status != 0 ? status : std::numeric_limits<unsigned>::max());
+
+    runningCoordinator.store(&coordinator);
+    const bool valid = coordinator.Run(job);
+    runningCoordinator.store(nullptr);
+
+    if (!valid) {
+        std::cerr << "invalid job, check the patterns and the split key"
+                  << " (bc1q patterns need --compressed or --both)" << std::endl;
+        return 2;
+    }
+    return 0;
+}
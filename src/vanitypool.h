@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "arith_uint256.h"
+#include "vanitysearch.h"
+
+namespace cosmyc {
+
+
+/// What a coordinator hands out: the search every worker runs and how
+/// the keyspace is cut into ranges.
+struct VanityJob
+{
+    std::vector<std::string>    patterns;
+    KEY_FORMATS                 formats;
+    bool                        symmetries;
+    SPLIT_KEY_MODE              splitKeyMode;
+    std::vector<unsigned char>  splitKey;
+
+    /// End the job once every pattern has a match and keep only the
+    /// first match of each pattern
+    bool                        stopOnMatch;
+
+    /// Points per range, a worker splits its range among its threads
+    uint64_t                    rangeLength;
+
+    /// Number of ranges in the job, 0 to keep handing out new ones
+    uint64_t                    maxRanges;
+
+    VanityJob();
+};
+
+/// One connected worker as the coordinator sees it
+struct VanityPoolWorkerReport
+{
+    std::string name;
+    unsigned    threads;
+    bool        busy;               // has a range
+    uint64_t    range;
+    uint64_t    keys;               // keys of the range tested so far
+    double      keysPerSecond;      // last heartbeat
+    double      lastSeen;           // seconds ago
+};
+
+/// Snapshot of a coordinator
+struct VanityPoolReport
+{
+    uint64_t    rangesIssued;       // first assignments, not reassignments
+    uint64_t    rangesDone;
+    uint64_t    rangesReassigned;
+    double      keysPerSecond;      // sum over all workers
+    double      elapsed;            // seconds
+
+    std::vector<VanityPoolWorkerReport> workers;
+    std::vector<VanityMatch>            matches;
+};
+
+/// Hands out disjoint ranges of one keyspace to any number of worker
+/// processes and collects their matches.
+///
+/// Range r of a job covers the private keys base + r * rangeLength ..
+/// base + (r + 1) * rangeLength - 1 for a random base, so no two workers
+/// ever test the same key. A worker that disconnects or misses its
+/// heartbeats for HEARTBEAT_TIMEOUT seconds loses its range, which then
+/// goes to the next idle worker; its matches so far are kept.
+///
+/// Workers connect over TCP ("tcp:host:port") or a Unix domain socket
+/// ("unix:/path"). The protocol is text messages in length-prefixed
+/// frames, see vanitypool.cpp. It carries only partial keys in split-key
+/// mode, but no authentication: listen on trusted networks only.
+class VanityCoordinator
+{
+public:
+    static const unsigned HEARTBEAT_TIMEOUT = 30;
+
+    VanityCoordinator();
+    ~VanityCoordinator();
+
+    /// Binds the listening socket, returns false if that fails
+    bool Listen(const std::string &address);
+
+    /// Serves job until it is finished or Stop() is called. Returns false
+    /// if the job is invalid or Listen() was not called.
+    bool Run(const VanityJob &job);
+
+    /// Ends Run() within a second, may be called from any thread
+    void Stop();
+
+    /// Prints every new match and a status line every interval seconds
+    /// to stdout while running, 0 for quiet
+    void SetVerbose(unsigned interval);
+
+    /// Only valid from the thread calling Run(), e.g. after it returns
+    VanityPoolReport Report() const;
+
+private:
+    struct Connection
+    {
+        int         fd;
+        std::string input;
+        std::string name;
+        unsigned    threads;
+        bool        greeted;
+        bool        busy;
+        uint64_t    range;
+        uint64_t    keys;
+        double      keysPerSecond;
+
+        std::chrono::steady_clock::time_point lastSeen;
+    };
+
+    void Accept();
+    bool Receive(Connection &connection);
+    bool Handle(Connection &connection, const std::string &message);
+    bool Assign(Connection &connection);
+    void Release(Connection &connection);
+    void Broadcast(const std::string &message);
+
+    /// True if match is for a pattern of the job and its key, with the
+    /// split key of the job, really gives its public key and address
+    bool IsGenuine(const VanityMatch &match) const;
+    void AddMatch(const VanityMatch &match);
+    bool Finished() const;
+    void PrintStatus() const;
+
+    int                         FListener;
+    std::string                 FUnixPath;  // removed again on exit
+    VanityJob                   FJob;
+    std::string                 FJobMessage;
+    size_t                      FPatternCount;  // distinct patterns
+    arith_uint256               FBase;
+
+    std::vector<Connection>     FConnections;
+    std::deque<uint64_t>        FRequeued;  // ranges of lost workers
+    uint64_t                    FNextRange;
+    uint64_t                    FRangesDone;
+    uint64_t                    FReassigned;
+
+    std::set<std::string>       FSeen;      // pattern and address of every match
+    std::set<std::string>       FMatched;   // patterns with a match
+    std::vector<VanityMatch>    FMatches;
+
+    unsigned                    FVerbose;
+    std::atomic<bool>           FStop;
+
+    std::chrono::steady_clock::time_point FStarted;
+};
+
+/// Worker process side: connects to a coordinator, runs every range it
+/// gets with a VanitySearch and streams back matches and heartbeats.
+class VanityPoolWorker
+{
+public:
+    static const unsigned HEARTBEAT_INTERVAL = 5;
+
+    VanityPoolWorker();
+    ~VanityPoolWorker();
+
+    /// Returns false if the coordinator cannot be reached
+    bool Connect(const std::string &address);
+
+    /// Works until the coordinator ends the job (true) or the connection
+    /// fails or Stop() is called (false).
+    /// threads == 0 means the default of the placement policy.
+    bool Run(unsigned threads = 0, const std::string &name = std::string());
+
+    /// Ends Run() within a second, may be called from any thread
+    void Stop();
+
+    /// True if Run() returned false because this worker cannot run the
+    /// job it got, the coordinator was told so
+    bool Rejected() const;
+
+    /// How the search threads are pinned, see VanitySearch::SetPlacement().
+    /// Call it before Run().
+    void SetPlacement(PLACEMENT_POLICY policy);
+
+private:
+    bool Send(const std::string &message);
+    bool StartRange(const std::string &message);
+    bool SendProgress(bool finished, bool heartbeat);
+
+    int                 FSocket;
+    unsigned            FThreads;
+    PLACEMENT_POLICY    FPlacement;
+    VanityJob           FJob;
+    bool                FHasJob;
+    bool                FRejected;
+    VanitySearch        FSearch;
+    bool                FBusy;
+    uint64_t            FRange;
+    size_t              FSent;      // matches of the range sent so far
+    std::atomic<bool>   FStop;
+};
+
+/// Command line front end, argv[1] is "--coordinator" or "--worker".
+/// Returns the process exit code.
+int VanityPoolMain(int argc, char *argv[]);
+
+
+} // namespace cosmyc
@@ -0,0 +1,707 @@
+#include "vanityscheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <math.h>
+#include <signal.h>
+#include <sstream>
+#include <stdlib.h>
+
+#include "vanitypattern.h"
+
+namespace {
+
+/// How often the scheduler books progress and looks for matches
+const unsigned  TICK = 1;   // seconds
+
+const unsigned  DEFAULT_QUANTUM = 10;   // seconds
+
+double secondsSince(const std::chrono::steady_clock::time_point &from)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+}
+
+/// JSON number, null for infinity and NaN
+std::string jsonNumber(double value)
+{
+    if (!std::isfinite(value))
+        return "null";
+
+    std::ostringstream ss;
+    ss.precision(17);
+    ss << value;
+    return ss.str();
+}
+
+/// JSON string, the values here never need more than quote escaping
+std::string jsonString(const std::string &value)
+{
+    std::string result = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+const char *stateName(cosmyc::ORDER_STATE state)
+{
+    switch (state) {
+    case cosmyc::osQueued:      return "queued";
+    case cosmyc::osRunning:     return "running";
+    case cosmyc::osDone:        return "done";
+    case cosmyc::osCancelled:   return "cancelled";
+    }
+    return "unknown";
+}
+
+const char *actionName(cosmyc::SCHEDULER_ACTION action)
+{
+    switch (action) {
+    case cosmyc::saRun:         return "run";
+    case cosmyc::saPreempt:     return "preempt";
+    case cosmyc::saQuantum:     return "quantum";
+    case cosmyc::saReload:      return "reload";
+    case cosmyc::saMatch:       return "match";
+    case cosmyc::saCancel:      return "cancel";
+    }
+    return "unknown";
+}
+
+std::atomic<bool> interrupted(false);
+
+void onInterrupt(int)
+{
+    interrupted.store(true);
+}
+
+} // namespace
+
+
+cosmyc::VanityOrder::VanityOrder()
+    : bounty(0)
+    , splitKeyMode(skNone)
+{
+}
+
+
+cosmyc::VanityScheduler::VanityScheduler()
+    : FThreads(0)
+    , FQuantum(DEFAULT_QUANTUM)
+    , FFormats(kfUncompressed)
+    , FSymmetries(false)
+    , FPlacement(ppNone)
+    , FLastKeys(0)
+    , FNextId(1)
+    , FSequence(0)
+    , FChanged(false)
+    , FStop(true)
+    , FStarted(std::chrono::steady_clock::now())
+{
+}
+
+cosmyc::VanityScheduler::~VanityScheduler()
+{
+    Stop();
+}
+
+void cosmyc::VanityScheduler::SetThreads(unsigned threads)
+{
+    std::lock_guard<std::mutex> lock(FLock);
+    FThreads = threads;
+}
+
+void cosmyc::VanityScheduler::SetQuantum(unsigned seconds)
+{
+    std::lock_guard<std::mutex> lock(FLock);
+    FQuantum = std::max(TICK, seconds);
+}
+
+void cosmyc::VanityScheduler::SetFormats(KEY_FORMATS formats)
+{
+    std::lock_guard<std::mutex> lock(FLock);
+    FFormats = formats;
+}
+
+void cosmyc::VanityScheduler::SetSymmetries(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(FLock);
+    FSymmetries = enabled;
+}
+
+void cosmyc::VanityScheduler::SetPlacement(PLACEMENT_POLICY policy)
+{
+    std::lock_guard<std::mutex> lock(FLock);
+    FPlacement = policy;
+}
+
+bool cosmyc::VanityScheduler::Start()
+{
+    if (FThread.joinable())
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(FLock);
+        FStop = false;
+        FStarted = std::chrono::steady_clock::now();
+    }
+
+    FThread = std::thread(&VanityScheduler::Scheduler, this);
+    return true;
+}
+
+void cosmyc::VanityScheduler::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(FLock);
+        FStop = true;
+        FWake.notify_all();
+    }
+
+    if (FThread.joinable())
+        FThread.join();
+}
+
+bool cosmyc::VanityScheduler::IsRunning() const
+{
+    std::lock_guard<std::mutex> lock(FLock);
+    return !FStop;
+}
+
+uint64_t cosmyc::VanityScheduler::AddOrder(const VanityOrder &order)
+{
+    VanityPattern compiled;
+    if (!compiled.Compile(order.pattern))
+        return 0;
+
+    const bool split = order.splitKeyMode != skNone && !order.splitKey.empty();
+    if (split && !VanitySearch().SetSplitKey(order.splitKey, order.splitKeyMode))
+        return 0;
+
+    Order entry;
+    entry.order = order;
+    if (!split) {
+        entry.order.splitKey.clear();
+        entry.order.splitKeyMode = skNone;
+    }
+    entry.complexity = compiled.Complexity();
+    entry.lavishness = VanityPattern::Lavishness(order.bounty, entry.complexity);
+    entry.state = osQueued;
+    entry.runSeconds = 0;
+    entry.addresses = 0;
+    entry.hasMatch = false;
+
+    std::lock_guard<std::mutex> lock(FLock);
+
+    // bc1q addresses only hash compressed keys, such an order could never match
+    if (compiled.Type() == atP2WPKH && (FFormats & kfCompressed) == 0)
+        return 0;
+
+    const uint64_t      id = FNextId++;
+    const std::string   key = GroupKey(entry.order.splitKey, entry.order.splitKeyMode);
+    FOrders[id] = entry;
+
+    auto found = FGroups.find(key);
+    if (found == FGroups.end()) {
+        Group group;
+        group.splitKey = entry.order.splitKey;
+        group.splitKeyMode = entry.order.splitKeyMode;
+        group.started = false;
+        group.pass = 0;
+        found = FGroups.insert(std::make_pair(key, group)).first;
+    }
+
+    // A group that was idle starts where the others are, it gets its
+    // share from now on but no credit for the time it had nothing to do
+    Group &group = found->second;
+    if (group.orders.empty())
+        group.pass = std::max(group.pass, LowestPass());
+    group.orders.push_back(id);
+
+    // Only the most lavish of several newcomers preempts
+    if (!FRunning.empty() && key != FRunning) {
+        double bar = Lavishness(FGroups[FRunning]);
+        if (!FPreemptBy.empty())
+            bar = std::max(bar, Lavishness(FGroups[FPreemptBy]));
+        if (Lavishness(group) > bar)
+            FPreemptBy = key;
+    }
+
+    FChanged = true;
+    FWake.notify_all();
+    return id;
+}
+
+bool cosmyc::VanityScheduler::CancelOrder(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(FLock);
+
+    auto found = FOrders.find(id);
+    if (found == FOrders.end() || found->second.state == osDone || found->second.state == osCancelled)
+        return false;
+
+    Order &order = found->second;
+    order.state = osCancelled;
+
+    // The scheduler reloads the running group when its orders changed
+    Group &group = FGroups[GroupKey(order.order.splitKey, order.order.splitKeyMode)];
+    group.orders.erase(std::remove(group.orders.begin(), group.orders.end(), id), group.orders.end());
+    Decide(saCancel, group);
+
+    FChanged = true;
+    FWake.notify_all();
+    return true;
+}
+
+size_t cosmyc::VanityScheduler::ActiveOrders() const
+{
+    std::lock_guard<std::mutex> lock(FLock);
+
+    size_t count = 0;
+    for (const auto &entry : FOrders) {
+        if (entry.second.state == osQueued || entry.second.state == osRunning)
+            count++;
+    }
+    return count;
+}
+
+void cosmyc::VanityScheduler::Scheduler()
+{
+    std::unique_lock<std::mutex> lock(FLock);
+
+    auto last = std::chrono::steady_clock::now();
+    auto sliceStarted = last;
+
+    while (!FStop) {
+        FWake.wait_for(lock, std::chrono::seconds(TICK), [this] { return FStop || FChanged; });
+        FChanged = false;
+        if (FStop)
+            break;
+
+        const auto      now = std::chrono::steady_clock::now();
+        const double    seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        Group *running = FRunning.empty() ? nullptr : &FGroups[FRunning];
+        if (running)
+            Collect(*running, seconds);
+
+        // A more lavish newcomer first, then whoever is furthest behind
+        // its share once the time slice is over
+        Group               *next = nullptr;
+        SCHEDULER_ACTION    reason = saRun;
+
+        if (!FPreemptBy.empty()) {
+            Group &candidate = FGroups[FPreemptBy];
+            FPreemptBy.clear();
+            if (running && &candidate != running && !candidate.orders.empty()) {
+                next = &candidate;
+                reason = saPreempt;
+            }
+        }
+
+        if (!next) {
+            if (!running || running->orders.empty()) {
+                next = NextGroup();
+            } else if (secondsSince(sliceStarted) >= FQuantum) {
+                next = NextGroup();
+                reason = saQuantum;
+                if (next == running) {
+                    next = nullptr;
+                    sliceStarted = now;
+                }
+            }
+        }
+
+        if (next && next != running) {
+            if (running) {
+                Unload(*running, 0);
+                if (!running->orders.empty())
+                    Decide(reason, *running);
+            }
+
+            Load(*next);
+            FRunning = GroupKey(next->splitKey, next->splitKeyMode);
+            Decide(saRun, *next);
+            sliceStarted = now;
+        } else if (running && running->orders.empty()) {
+            Unload(*running, 0);
+            FRunning.clear();
+        } else if (running && (running->orders != running->loaded || !FSearch.IsRunning())) {
+            // Orders joined or left, the search keeps its keyspace
+            Unload(*running, 0);
+            Load(*running);
+            Decide(saReload, *running);
+        }
+    }
+
+    if (!FRunning.empty()) {
+        Unload(FGroups[FRunning], secondsSince(last));
+        FRunning.clear();
+    }
+}
+
+void cosmyc::VanityScheduler::Collect(Group &group, double seconds)
+{
+    const VanityReport report = FSearch.Report();
+
+    // Keys, not hash160s: P2TR orders hash nothing. Each order books the
+    // addresses of its own kind.
+    const uint64_t tested = report.keysTested > FLastKeys ? report.keysTested - FLastKeys : 0;
+    FLastKeys = report.keysTested;
+
+    const double lavishness = Lavishness(group);
+    group.pass += lavishness > 0 ? seconds / lavishness : std::numeric_limits<double>::infinity();
+
+    for (size_t k = 0; k < group.loaded.size(); k++) {
+        Order &order = FOrders[group.loaded[k]];
+        if (order.state != osRunning)
+            continue;
+        order.runSeconds += seconds;
+        if (k < report.patterns.size())
+            order.addresses += uint64_t(tested * report.patterns[k].addressesPerKey);
+    }
+
+    // Every address goes to one order only, even if two orders of the
+    // group have the same pattern
+    bool matched = false;
+    for (size_t k = 0; k < group.loaded.size() && k < report.patterns.size(); k++) {
+        Order &order = FOrders[group.loaded[k]];
+        if (report.patterns[k].hits == 0 || order.state != osRunning)
+            continue;
+
+        for (const auto &match : report.matches) {
+            if (match.pattern != order.order.pattern || !FAssigned.insert(match.address).second)
+                continue;
+
+            order.state = osDone;
+            order.hasMatch = true;
+            order.match = match;
+            group.orders.erase(std::remove(group.orders.begin(), group.orders.end(), group.loaded[k]),
+                               group.orders.end());
+            matched = true;
+            break;
+        }
+    }
+
+    if (matched)
+        Decide(saMatch, group);
+}
+
+void cosmyc::VanityScheduler::Load(Group &group)
+{
+    std::vector<std::string> patterns;
+    for (uint64_t id : group.orders) {
+        patterns.push_back(FOrders[id].order.pattern);
+        FOrders[id].state = osRunning;
+    }
+
+    if (!group.started) {
+        FSearch.SetSymmetries(FSymmetries);
+        FSearch.SetPlacement(FPlacement);
+        FSearch.SetSplitKey(group.splitKey, group.splitKeyMode);
+        group.started = FSearch.Start(patterns, FThreads, FFormats, true);
+    } else {
+        // Same workers and keyspace, only the patterns change
+        VanityCheckpoint checkpoint = group.checkpoint;
+        checkpoint.patterns = patterns;
+        checkpoint.hits.assign(patterns.size(), 0);
+        checkpoint.matches.clear();
+        FSearch.Resume(checkpoint);
+    }
+
+    group.loaded = group.orders;
+    FLastKeys = FSearch.Report().keysTested;
+}
+
+void cosmyc::VanityScheduler::Unload(Group &group, double seconds)
+{
+    FSearch.Stop();
+    Collect(group, seconds);
+    group.checkpoint = FSearch.Checkpoint();
+
+    for (uint64_t id : group.loaded) {
+        if (FOrders[id].state == osRunning)
+            FOrders[id].state = osQueued;
+    }
+    group.loaded.clear();
+}
+
+double cosmyc::VanityScheduler::Lavishness(const Group &group) const
+{
+    // One key tested serves every pattern of the group
+    double sum = 0;
+    for (uint64_t id : group.orders)
+        sum += FOrders.at(id).lavishness;
+    return sum;
+}
+
+double cosmyc::VanityScheduler::LowestPass() const
+{
+    double lowest = std::numeric_limits<double>::infinity();
+    for (const auto &entry : FGroups) {
+        if (!entry.second.orders.empty())
+            lowest = std::min(lowest, entry.second.pass);
+    }
+    return std::isfinite(lowest) ? lowest : 0;
+}
+
+cosmyc::VanityScheduler::Group *cosmyc::VanityScheduler::NextGroup()
+{
+    Group   *best = nullptr;
+    double  bestLavishness = 0;
+
+    for (auto &entry : FGroups) {
+        Group &group = entry.second;
+        if (group.orders.empty())
+            continue;
+
+        const double lavishness = Lavishness(group);
+        if (!best || group.pass < best->pass
+                || (group.pass == best->pass && lavishness > bestLavishness)) {
+            best = &group;
+            bestLavishness = lavishness;
+        }
+    }
+    return best;
+}
+
+void cosmyc::VanityScheduler::Decide(SCHEDULER_ACTION action, const Group &group)
+{
+    VanitySchedulerDecision decision;
+    decision.sequence = FSequence++;
+    decision.time = secondsSince(FStarted);
+    decision.action = action;
+    decision.group = group.splitKey.empty() ? std::string("-") : group.splitKey;
+    decision.orders = group.orders;
+    decision.lavishness = Lavishness(group);
+    decision.pass = group.pass;
+
+    FDecisions.push_back(decision);
+    if (FDecisions.size() > MAX_DECISIONS)
+        FDecisions.pop_front();
+}
+
+std::string cosmyc::VanityScheduler::GroupKey(const std::string &splitKey, SPLIT_KEY_MODE mode)
+{
+    std::string key = splitKey;
+    std::transform(key.begin(), key.end(), key.begin(), ::toupper);
+
+    std::ostringstream ss;
+    ss << int(mode) << ":" << key;
+    return ss.str();
+}
+
+cosmyc::VanitySchedulerReport cosmyc::VanityScheduler::Report() const
+{
+    VanitySchedulerReport report;
+
+    std::lock_guard<std::mutex> lock(FLock);
+
+    report.running = !FStop;
+    report.threads = FThreads != 0 ? FThreads : std::max(1u, CpuTopology::Get().DefaultThreads(FPlacement));
+    report.elapsed = secondsSince(FStarted);
+    report.addressesPerSecond = 0;
+
+    if (!FRunning.empty()) {
+        const Group &group = FGroups.at(FRunning);
+        report.runningGroup = group.splitKey.empty() ? std::string("-") : group.splitKey;
+        report.addressesPerSecond = FSearch.Report().addressesPerSecond;
+    }
+
+    for (const auto &entry : FOrders) {
+        const Order &order = entry.second;
+
+        VanityOrderReport orderReport;
+        orderReport.id = entry.first;
+        orderReport.pattern = order.order.pattern;
+        orderReport.bounty = order.order.bounty;
+        orderReport.complexity = order.complexity;
+        orderReport.lavishness = order.lavishness;
+        orderReport.state = order.state;
+        orderReport.runSeconds = order.runSeconds;
+        orderReport.addresses = order.addresses;
+        orderReport.addressesPerSecond = order.runSeconds > 0 ? order.addresses / order.runSeconds : 0;
+        orderReport.hasMatch = order.hasMatch;
+        orderReport.match = order.match;
+        report.orders.push_back(orderReport);
+    }
+
+    report.decisions.assign(FDecisions.begin(), FDecisions.end());
+    return report;
+}
+
+std::string cosmyc::VanityScheduler::ReportJson(const VanitySchedulerReport &report)
+{
+    std::ostringstream ss;
+
+    ss << "{\"running\":" << (report.running ? "true" : "false")
+       << ",\"threads\":" << report.threads
+       << ",\"elapsed\":" << jsonNumber(report.elapsed)
+       << ",\"runningGroup\":" << (report.runningGroup.empty() ? std::string("null") : jsonString(report.runningGroup))
+       << ",\"addressesPerSecond\":" << jsonNumber(report.addressesPerSecond);
+
+    ss << ",\"orders\":[";
+    for (size_t k = 0; k < report.orders.size(); k++) {
+        const VanityOrderReport &order = report.orders[k];
+        if (k > 0)
+            ss << ",";
+        ss << "{\"id\":" << order.id
+           << ",\"pattern\":" << jsonString(order.pattern)
+           << ",\"bounty\":" << order.bounty
+           << ",\"complexity\":" << jsonNumber(order.complexity)
+           << ",\"lavishness\":" << jsonNumber(order.lavishness)
+           << ",\"state\":" << jsonString(stateName(order.state))
+           << ",\"runSeconds\":" << jsonNumber(order.runSeconds)
+           << ",\"addresses\":" << order.addresses
+           << ",\"addressesPerSecond\":" << jsonNumber(order.addressesPerSecond)
+           << ",\"address\":" << (order.hasMatch ? jsonString(order.match.address) : std::string("null"))
+           << "}";
+    }
+    ss << "]";
+
+    ss << ",\"decisions\":[";
+    for (size_t k = 0; k < report.decisions.size(); k++) {
+        const VanitySchedulerDecision &decision = report.decisions[k];
+        if (k > 0)
+            ss << ",";
+        ss << "{\"sequence\":" << decision.sequence
+           << ",\"time\":" << jsonNumber(decision.time)
+           << ",\"action\":" << jsonString(actionName(decision.action))
+           << ",\"group\":" << jsonString(decision.group)
+           << ",\"lavishness\":" << jsonNumber(decision.lavishness)
+           << ",\"pass\":" << jsonNumber(decision.pass)
+           << ",\"orders\":[";
+        for (size_t n = 0; n < decision.orders.size(); n++)
+            ss << (n > 0 ? "," : "") << decision.orders[n];
+        ss << "]}";
+    }
+    ss << "]}";
+
+    return ss.str();
+}
+
+
+int cosmyc::VanitySchedulerMain(int argc, char *argv[])
+{
+    VanityScheduler scheduler;
+
+    for (int k = 2; k < argc; k++) {
+        const std::string option = argv[k];
+        const bool hasValue = k + 1 < argc;
+
+        if (option == "--threads" && hasValue) {
+            scheduler.SetThreads(unsigned(atoi(argv[++k])));
+        } else if (option == "--quantum" && hasValue) {
+            scheduler.SetQuantum(unsigned(atoi(argv[++k])));
+        } else if (option == "--compressed") {
+            scheduler.SetFormats(kfCompressed);
+        } else if (option == "--both") {
+            scheduler.SetFormats(kfBoth);
+        } else if (option == "--symmetries") {
+            scheduler.SetSymmetries(true);
+        } else if (option == "--placement" && hasValue) {
+            PLACEMENT_POLICY policy = ppNone;
+            if (!CpuTopology::ParsePolicy(argv[++k], policy)) {
+                std::cerr << "unknown placement " << argv[k] << "\n";
+                return 2;
+            }
+            scheduler.SetPlacement(policy);
+        } else {
+            std::cerr
+                << "usage: " << argv[0] << " --scheduler [--threads <n>] [--quantum <seconds>]\n"
+                << "       [--compressed | --both] [--symmetries]\n"
+                << "       [--placement none|compact|spread|physical]\n"
+                << "\n"
+                << "Reads one order per line from stdin:\n"
+                << "  <pattern> <bounty> [<split key> [multiplicative]]\n"
+                << "  cancel <id>\n"
+                << "and prints the report as JSON once every order is done.\n";
+            return 2;
+        }
+    }
+
+    if (!scheduler.Start())
+        return 1;
+
+    // Decisions and matches as they happen
+    std::atomic<bool>   finished(false);
+    std::thread         printer([&scheduler, &finished] {
+        uint64_t            nextDecision = 0;
+        std::set<uint64_t>  printed;
+
+        while (!finished.load()) {
+            const VanitySchedulerReport report = scheduler.Report();
+
+            for (const auto &decision : report.decisions) {
+                if (decision.sequence < nextDecision)
+                    continue;
+                nextDecision = decision.sequence + 1;
+
+                std::cout << "decision " << decision.sequence << " " << decision.time
+                          << " " << actionName(decision.action) << " group " << decision.group
+                          << " lavishness " << decision.lavishness << " orders";
+                for (uint64_t id : decision.orders)
+                    std::cout << " " << id;
+                std::cout << std::endl;
+            }
+
+            for (const auto &order : report.orders) {
+                if (!order.hasMatch || !printed.insert(order.id).second)
+                    continue;
+                std::cout << "match " << order.id << " " << order.pattern << " " << order.match.address
+                          << (order.match.splitKey == skNone ? " private " : " partial ")
+                          << order.match.privateKey << std::endl;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        }
+    });
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream  ss(line);
+        std::string         first;
+
+        if (!(ss >> first) || first[0] == '#')
+            continue;
+
+        if (first == "cancel") {
+            uint64_t id = 0;
+            ss >> id;
+            std::cout << (scheduler.CancelOrder(id) ? "cancelled " : "cannot cancel ") << id << std::endl;
+            continue;
+        }
+
+        VanityOrder order;
+        std::string mode;
+        order.pattern = first;
+        ss >> order.bounty >> order.splitKey >> mode;
+        if (!order.splitKey.empty())
+            order.splitKeyMode = mode == "multiplicative" ? skMultiplicative : skAdditive;
+
+        const uint64_t id = scheduler.AddOrder(order);
+        if (id != 0)
+            std::cout << "order " << id << " " << order.pattern << std::endl;
+        else
+            std::cout << "invalid order: " << line << std::endl;
+    }
+
+    // No more orders, run the queue dry
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+    while (scheduler.ActiveOrders() != 0 && !interrupted.load())
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+    // Lets the printer show the last matches
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    finished.store(true);
+    printer.join();
+
+    scheduler.Stop();
+    std::cout << VanityScheduler::ReportJson(scheduler.Report()) << std::endl;
+    return 0;
+}
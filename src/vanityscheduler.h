@@ -0,0 +1,222 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+#include "vanitysearch.h"
+
+namespace cosmyc {
+
+
+/// One customer's vanity order
+struct VanityOrder
+{
+    std::string     pattern;
+    uint64_t        bounty;         // any unit, only ratios matter
+
+    /// Customer public key (hex) of a split-key order, empty for none
+    std::string     splitKey;
+    SPLIT_KEY_MODE  splitKeyMode;
+
+    VanityOrder();
+};
+
+typedef enum _ORDER_STATE
+{
+    osQueued = 0,       // waiting for its group to be scheduled
+    osRunning,
+    osDone,             // has its match
+    osCancelled
+} ORDER_STATE;
+
+/// Progress and throughput of one order
+struct VanityOrderReport
+{
+    uint64_t        id;
+    std::string     pattern;
+    uint64_t        bounty;
+    double          complexity;     // see Vanity::PatternComplexity
+    double          lavishness;     // see Vanity::PatternLavishness
+    ORDER_STATE     state;
+
+    double          runSeconds;     // wall time its group was running
+    uint64_t        addresses;      // of its kind tested while it ran
+    double          addressesPerSecond;
+
+    bool            hasMatch;
+    VanityMatch     match;
+};
+
+/// Why the scheduler started or stopped a group
+typedef enum _SCHEDULER_ACTION
+{
+    saRun = 0,          // group started or resumed
+    saPreempt,          // running group stopped for a more lavish one
+    saQuantum,          // running group used up its time slice
+    saReload,           // orders of the running group changed
+    saMatch,            // an order got its match
+    saCancel            // an order was cancelled
+} SCHEDULER_ACTION;
+
+struct VanitySchedulerDecision
+{
+    uint64_t                sequence;
+    double                  time;       // seconds since Start()
+    SCHEDULER_ACTION        action;
+    std::string             group;      // split key of the group, "-" for none
+    std::vector<uint64_t>   orders;     // active orders of the group
+    double                  lavishness; // of the group
+    double                  pass;       // virtual time of the group
+};
+
+struct VanitySchedulerReport
+{
+    bool            running;
+    unsigned        threads;
+    double          elapsed;            // seconds
+    std::string     runningGroup;       // empty when idle
+    double          addressesPerSecond; // of the running group
+
+    std::vector<VanityOrderReport>          orders;
+    std::vector<VanitySchedulerDecision>    decisions;  // the last MAX_DECISIONS
+};
+
+/// Runs many vanity orders on one machine with CPU time proportional to
+/// their lavishness (reward per unit of work).
+///
+/// Orders with the same split key form a group that shares one
+/// VanitySearch: every key tested is checked against all patterns of the
+/// group at once, so cheap orders ride along for free. Groups take turns
+/// on all threads in time slices of SetQuantum() seconds, chosen by
+/// stride scheduling: a running group's pass grows by run time divided by
+/// its lavishness (the sum over its orders) and the group with the
+/// lowest pass runs next. A group that joins starts at the lowest pass
+/// around, so it gets its share from then on but no catch-up burst.
+///
+/// An order that makes its group more lavish than the running one
+/// preempts that right away. Preempted groups keep a VanityCheckpoint and
+/// continue exactly where they stopped.
+class VanityScheduler
+{
+public:
+    static const size_t MAX_DECISIONS = 1000;
+
+    VanityScheduler();
+    ~VanityScheduler();
+
+    /// Threads of the search, 0 for the default of the placement policy.
+    /// Takes effect on the next Start().
+    void SetThreads(unsigned threads);
+
+    /// Seconds a group runs before the scheduler looks for a group that
+    /// is behind its share
+    void SetQuantum(unsigned seconds);
+
+    /// Key formats, symmetries and thread placement of all searches, see
+    /// VanitySearch. Take effect on the next Start().
+    void SetFormats(KEY_FORMATS formats);
+    void SetSymmetries(bool enabled);
+    void SetPlacement(PLACEMENT_POLICY policy);
+
+    bool Start();
+    void Stop();
+    bool IsRunning() const;
+
+    /// Queues an order, returns its id or 0 if the pattern or the split
+    /// key is invalid, or if it is a bc1q pattern and the formats don't
+    /// include compressed keys. Orders may be added before and after Start().
+    uint64_t AddOrder(const VanityOrder &order);
+
+    /// Returns false if there is no such order waiting or running
+    bool CancelOrder(uint64_t id);
+
+    /// Orders that are neither done nor cancelled
+    size_t ActiveOrders() const;
+
+    VanitySchedulerReport Report() const;
+
+    /// report as a JSON object, without private keys
+    static std::string ReportJson(const VanitySchedulerReport &report);
+
+private:
+    struct Order
+    {
+        VanityOrder     order;
+        double          complexity;
+        double          lavishness;
+        ORDER_STATE     state;
+        double          runSeconds;
+        uint64_t        addresses;
+        bool            hasMatch;
+        VanityMatch     match;
+    };
+
+    struct Group
+    {
+        std::string             splitKey;
+        SPLIT_KEY_MODE          splitKeyMode;
+        std::vector<uint64_t>   orders;     // active orders
+        std::vector<uint64_t>   loaded;     // the patterns of the search, in order
+        bool                    started;
+        VanityCheckpoint        checkpoint; // while not running
+        double                  pass;
+    };
+
+    void Scheduler();
+
+    /// Books the time and addresses since the last call on the running
+    /// group and takes matched orders out of it
+    void Collect(Group &group, double seconds);
+
+    void Load(Group &group);
+    void Unload(Group &group, double seconds);
+
+    double Lavishness(const Group &group) const;
+    double LowestPass() const;
+    Group *NextGroup();
+    void Decide(SCHEDULER_ACTION action, const Group &group);
+
+    static std::string GroupKey(const std::string &splitKey, SPLIT_KEY_MODE mode);
+
+    unsigned                    FThreads;
+    unsigned                    FQuantum;
+    KEY_FORMATS                 FFormats;
+    bool                        FSymmetries;
+    PLACEMENT_POLICY            FPlacement;
+
+    VanitySearch                FSearch;
+    std::map<uint64_t, Order>   FOrders;
+    std::map<std::string, Group> FGroups;
+    std::string                 FRunning;       // key of the running group
+    std::string                 FPreemptBy;     // key of a group to run at once
+    std::set<std::string>       FAssigned;      // addresses already given to an order
+    uint64_t                    FLastKeys;      // of the running search at the last Collect()
+    uint64_t                    FNextId;
+
+    std::deque<VanitySchedulerDecision> FDecisions;
+    uint64_t                    FSequence;
+
+    std::thread                 FThread;
+    mutable std::mutex          FLock;
+    std::condition_variable     FWake;
+    bool                        FChanged;
+    bool                        FStop;
+
+    std::chrono::steady_clock::time_point FStarted;
+};
+
+/// Command line front end (argv[1] is "--scheduler"): reads orders from
+/// stdin and prints decisions and matches. Returns the process exit code.
+int VanitySchedulerMain(int argc, char *argv[]);
+
+
+} // namespace cosmyc
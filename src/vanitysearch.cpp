@@ -0,0 +1,951 @@
+#include "vanitysearch.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <math.h>
+#include <set>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "crypto/hash160.h"
+#include "keywalker.h"
+#include "random.h"
+#include "utilstrencodings.h"
+#include "vanitypattern.h"
+
+namespace {
+
+std::string toHex(const unsigned char *data, size_t size)
+{
+    static const char hexAlphas[] = "0123456789ABCDEF";
+
+    std::string result;
+    result.reserve(size * 2);
+    for (size_t k = 0; k < size; k++) {
+        result += hexAlphas[(data[k] & 0xF0) >> 4];
+        result += hexAlphas[data[k] & 0xF];
+    }
+    return result;
+}
+
+/// Probability of at least one match within tested addresses
+double matchProbability(double tested, double complexity)
+{
+    return -expm1(-tested / complexity);
+}
+
+/// Seconds until the match probability reaches quantile
+double matchEta(double tested, double complexity, double rate, double quantile)
+{
+    const double needed = -log1p(-quantile) * complexity;
+
+    if (tested >= needed)
+        return 0;
+    if (rate <= 0)
+        return std::numeric_limits<double>::infinity();
+    return (needed - tested) / rate;
+}
+
+/// JSON number, null for infinity and NaN
+std::string jsonNumber(double value)
+{
+    if (!std::isfinite(value))
+        return "null";
+
+    std::ostringstream ss;
+    ss.precision(17);
+    ss << value;
+    return ss.str();
+}
+
+/// JSON string, the values here never need more than quote escaping
+std::string jsonString(const std::string &value)
+{
+    std::string result = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+/// Big-endian 32-byte private key of value
+void toKey(const arith_uint256 &value, unsigned char *seckey)
+{
+    for (size_t k = 0; k < cosmyc::KeyWalker::PRIVATE_KEY_SIZE; k++)
+        seckey[cosmyc::KeyWalker::PRIVATE_KEY_SIZE - 1 - k] = (value >> (8 * k)).GetLow64() & 0xFF;
+}
+
+/// Random valid private key, the start of a worker's slice. It is the
+/// key material of everything found there, so it comes from the OS
+/// generator, see GetStrongRandBytes().
+arith_uint256 randomStart()
+{
+    cosmyc::KeyWalker   walker(cosmyc::KeyWalker::MIN_BATCH_SIZE);
+    unsigned char       seckey[cosmyc::KeyWalker::PRIVATE_KEY_SIZE];
+    arith_uint256       start = 0;
+
+    do {
+        GetStrongRandBytes(seckey, sizeof(seckey));
+    } while (!walker.Reset(seckey));
+
+    for (size_t k = 0; k < sizeof(seckey); k++) {
+        start <<= 8;
+        start += seckey[k];
+    }
+
+    memset(seckey, 0, sizeof(seckey));
+    return start;
+}
+
+const char *CHECKPOINT_MAGIC = "cosmyc-vanity-checkpoint";
+const int   CHECKPOINT_VERSION = 1;
+
+/// Creates path readable by the owner only, writes text to it and waits
+/// until it is on disk. A stale file of an earlier attempt is replaced,
+/// not reused, so it cannot carry wider permissions over.
+bool writePrivateFile(const std::string &path, const std::string &text)
+{
+#ifdef _WIN32
+    _unlink(path.c_str());
+    const int fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    unlink(path.c_str());
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+#endif
+    if (fd < 0)
+        return false;
+
+    size_t written = 0;
+    while (written < text.size()) {
+#ifdef _WIN32
+        const int count = _write(fd, text.data() + written, unsigned(text.size() - written));
+#else
+        const ssize_t count = write(fd, text.data() + written, text.size() - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+#endif
+        if (count <= 0)
+            break;
+        written += size_t(count);
+    }
+
+#ifdef _WIN32
+    const bool synced = _commit(fd) == 0;
+    const bool closed = _close(fd) == 0;
+#else
+    const bool synced = fsync(fd) == 0;
+    const bool closed = close(fd) == 0;
+#endif
+    return written == text.size() && synced && closed;
+}
+
+/// Atomically replaces to with from, durable once it returns true: at
+/// any moment of a crash one of the two complete files is in place
+bool replaceFile(const std::string &from, const std::string &to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(from.c_str(), to.c_str()) != 0)
+        return false;
+
+    // The new name is only on disk with the directory
+    const size_t        slash = to.rfind('/');
+    const std::string   directory = slash == std::string::npos ? std::string(".")
+                                  : slash == 0 ? std::string("/") : to.substr(0, slash);
+    const int fd = open(directory.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    const bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+#endif
+}
+
+} // namespace
+
+
+cosmyc::VanitySearch::VanitySearch()
+    : FHashPatterns(false)
+    , FTaprootPatterns(false)
+    , FFormats(kfUncompressed)
+    , FStopOnMatch(true)
+    , FBatchSize(KeyWalker::DEFAULT_BATCH_SIZE)
+    , FSymmetries(false)
+    , FSplitKeyMode(skNone)
+    , FPlacement(ppNone)
+    , FCheckpointInterval(0)
+    , FUnmatched(0)
+    , FStop(false)
+    , FActive(0)
+    , FResumedKeys(0)
+    , FResumedHash160s(0)
+{
+}
+
+cosmyc::VanitySearch::~VanitySearch()
+{
+    Stop();
+}
+
+bool cosmyc::VanitySearch::Start(
+    const   std::string &pattern,
+            unsigned    threads,
+            KEY_FORMATS formats,
+            bool        stopOnMatch)
+{
+    return Start(std::vector<std::string>(1, pattern), threads, formats, stopOnMatch);
+}
+
+bool cosmyc::VanitySearch::Start(
+    const   std::vector<std::string>    &patterns,
+            unsigned                    threads,
+            KEY_FORMATS                 formats,
+            bool                        stopOnMatch)
+{
+    if (IsRunning())
+        return false;
+
+    if (threads == 0)
+        threads = std::max(1u, CpuTopology::Get().DefaultThreads(FPlacement));
+
+    // A new search is a checkpoint with nothing done yet
+    VanityCheckpoint checkpoint;
+    checkpoint.patterns = patterns;
+    checkpoint.formats = formats;
+    checkpoint.stopOnMatch = stopOnMatch;
+    checkpoint.batchSize = FBatchSize;
+    checkpoint.symmetries = FSymmetries;
+    checkpoint.splitKeyMode = FSplitKeyMode;
+    checkpoint.splitKey = FSplitKey;
+    checkpoint.hits.assign(patterns.size(), 0);
+
+    checkpoint.workers.resize(threads);
+    for (auto &worker : checkpoint.workers) {
+        worker.start = randomStart();
+        worker.steps = 0;
+        worker.limit = 0;
+        worker.keys = 0;
+        worker.hash160s = 0;
+        worker.matches = 0;
+    }
+
+    return Resume(checkpoint);
+}
+
+bool cosmyc::VanitySearch::Resume(const VanityCheckpoint &checkpoint)
+{
+    if (IsRunning())
+        return false;
+
+    // Join the workers of a previous search that stopped on its own
+    Stop();
+
+    const size_t threads = checkpoint.workers.size();
+    if (threads == 0
+            || (checkpoint.formats & kfBoth) == 0
+            || checkpoint.hits.size() != checkpoint.patterns.size())
+        return false;
+
+    KeyWalker       probe(KeyWalker::MIN_BATCH_SIZE);
+    unsigned char   seckey[KeyWalker::PRIVATE_KEY_SIZE];
+
+    for (const auto &worker : checkpoint.workers) {
+        toKey(worker.start, seckey);
+        if (!probe.Reset(seckey))
+            return false;
+    }
+    memset(seckey, 0, sizeof(seckey));
+
+    if (checkpoint.splitKeyMode != skNone
+            && (checkpoint.splitKey.empty()
+                || !probe.SetOffset(&checkpoint.splitKey[0], checkpoint.splitKey.size())))
+        return false;
+
+    FPatterns.Clear();
+    for (const auto &pattern : checkpoint.patterns) {
+        const bool unreachable = VanityPattern::TypeOf(pattern) == atP2WPKH
+                && (checkpoint.formats & kfCompressed) == 0;
+        if (unreachable || !FPatterns.Add(pattern)) {
+            FPatterns.Clear();
+            return false;
+        }
+    }
+    if (FPatterns.Size() == 0)
+        return false;
+
+    FPatterns.Build();
+
+    FHashPatterns = false;
+    FTaprootPatterns = false;
+    for (size_t k = 0; k < FPatterns.Size(); k++) {
+        if (FPatterns.Pattern(k).Type() == atP2TR)
+            FTaprootPatterns = true;
+        else
+            FHashPatterns = true;
+    }
+
+    FPatternList = checkpoint.patterns;
+    FFormats = checkpoint.formats;
+    FStopOnMatch = checkpoint.stopOnMatch;
+    FBatchSize = checkpoint.batchSize;
+    FSymmetries = checkpoint.symmetries;
+    FSplitKeyMode = checkpoint.splitKeyMode;
+    FSplitKey = checkpoint.splitKey;
+
+    {
+        std::lock_guard<std::mutex> lock(FLock);
+        FMatches = checkpoint.matches;
+        FStarted = std::chrono::steady_clock::now();
+        FFinished = FStarted;
+
+        // The counters carry on, the clock starts over
+        FResumedKeys = 0;
+        FResumedHash160s = 0;
+        for (const auto &worker : checkpoint.workers) {
+            FResumedKeys += worker.keys;
+            FResumedHash160s += worker.hash160s;
+        }
+    }
+
+    FStarts.resize(threads);
+    FLimits.resize(threads);
+    FCpus = CpuTopology::Get().Placement(FPlacement, threads);
+    FCounters = std::vector<WorkerCounter>(threads);
+    for (size_t k = 0; k < threads; k++) {
+        const VanityCheckpoint::Worker &worker = checkpoint.workers[k];
+
+        FStarts[k] = worker.start;
+        FLimits[k] = worker.limit;
+        FCounters[k].steps.store(worker.steps, std::memory_order_relaxed);
+        FCounters[k].keys.store(worker.keys, std::memory_order_relaxed);
+        FCounters[k].hash160s.store(worker.hash160s, std::memory_order_relaxed);
+        FCounters[k].matches.store(worker.matches, std::memory_order_relaxed);
+    }
+
+    size_t unmatched = 0;
+    FHits = std::vector<std::atomic<uint64_t> >(FPatterns.Size());
+    for (size_t k = 0; k < FHits.size(); k++) {
+        FHits[k].store(checkpoint.hits[k], std::memory_order_relaxed);
+        if (checkpoint.hits[k] == 0)
+            unmatched++;
+    }
+    FUnmatched.store(unmatched);
+
+    // A stopOnMatch search that had found everything just ends again
+    FStop.store(FStopOnMatch && unmatched == 0);
+    FActive.store(threads);
+
+    for (unsigned k = 0; k < threads; k++)
+        FThreads.push_back(std::thread(&VanitySearch::Worker, this, k));
+
+    if (!FCheckpointPath.empty())
+        FCheckpointThread = std::thread(&VanitySearch::CheckpointWorker, this);
+
+    return true;
+}
+
+void cosmyc::VanitySearch::Stop()
+{
+    FStop.store(true);
+
+    for (auto &thread : FThreads)
+        thread.join();
+    FThreads.clear();
+
+    // Saves the final state once the workers are gone
+    if (FCheckpointThread.joinable())
+        FCheckpointThread.join();
+}
+
+cosmyc::VanityCheckpoint cosmyc::VanitySearch::Checkpoint() const
+{
+    VanityCheckpoint checkpoint;
+
+    checkpoint.patterns = FPatternList;
+    checkpoint.formats = FFormats;
+    checkpoint.stopOnMatch = FStopOnMatch;
+    checkpoint.batchSize = FBatchSize;
+    checkpoint.symmetries = FSymmetries;
+    checkpoint.splitKeyMode = FSplitKeyMode;
+    checkpoint.splitKey = FSplitKey;
+
+    // Workers publish a batch under the same lock, so steps, hits
+    // and matches all describe the same set of tested keys
+    std::lock_guard<std::mutex> lock(FLock);
+
+    checkpoint.workers.resize(FCounters.size());
+    for (size_t k = 0; k < FCounters.size(); k++) {
+        VanityCheckpoint::Worker &worker = checkpoint.workers[k];
+
+        worker.start = FStarts[k];
+        worker.limit = FLimits[k];
+        worker.steps = FCounters[k].steps.load(std::memory_order_relaxed);
+        worker.keys = FCounters[k].keys.load(std::memory_order_relaxed);
+        worker.hash160s = FCounters[k].hash160s.load(std::memory_order_relaxed);
+        worker.matches = FCounters[k].matches.load(std::memory_order_relaxed);
+    }
+
+    checkpoint.hits.resize(FHits.size());
+    for (size_t k = 0; k < FHits.size(); k++)
+        checkpoint.hits[k] = FHits[k].load(std::memory_order_relaxed);
+
+    checkpoint.matches = FMatches;
+    return checkpoint;
+}
+
+void cosmyc::VanitySearch::SetAutoCheckpoint(const std::string &path, unsigned interval)
+{
+    FCheckpointPath = path;
+    FCheckpointInterval = std::max(1u, interval);
+}
+
+void cosmyc::VanitySearch::CheckpointWorker()
+{
+    std::unique_lock<std::mutex> lock(FCheckpointLock);
+
+    while (!FCheckpointWake.wait_for(lock, std::chrono::seconds(FCheckpointInterval), [this] { return !IsRunning(); }))
+        Checkpoint().Save(FCheckpointPath);
+
+    Checkpoint().Save(FCheckpointPath);
+}
+
+void cosmyc::VanitySearch::SetBatchSize(size_t batchSize)
+{
+    FBatchSize = batchSize;
+}
+
+void cosmyc::VanitySearch::SetSymmetries(bool enabled)
+{
+    FSymmetries = enabled;
+}
+
+void cosmyc::VanitySearch::SetPlacement(PLACEMENT_POLICY policy)
+{
+    FPlacement = policy;
+}
+
+bool cosmyc::VanitySearch::SetSplitKey(
+    const   std::string     &publicKey,
+            SPLIT_KEY_MODE  mode)
+{
+    if (publicKey.empty() || mode == skNone) {
+        FSplitKey.clear();
+        FSplitKeyMode = skNone;
+        return true;
+    }
+
+    if (!IsHex(publicKey))
+        return false;
+
+    std::vector<unsigned char> key = ParseHex(publicKey);
+    if (!KeyWalker(KeyWalker::MIN_BATCH_SIZE).SetOffset(&key[0], key.size()))
+        return false;
+
+    FSplitKey = key;
+    FSplitKeyMode = mode;
+    return true;
+}
+
+bool cosmyc::VanitySearch::IsRunning() const
+{
+    return FActive.load() != 0;
+}
+
+cosmyc::VanityReport cosmyc::VanitySearch::Report() const
+{
+    VanityReport report;
+
+    report.running = IsRunning();
+    report.threads = FCounters.size();
+    report.keysTested = 0;
+    report.hash160s = 0;
+    report.matchesFound = 0;
+
+    report.workers.resize(FCounters.size());
+    for (size_t k = 0; k < FCounters.size(); k++) {
+        VanityWorkerReport &worker = report.workers[k];
+
+        worker.keys = FCounters[k].keys.load(std::memory_order_relaxed);
+        worker.hash160s = FCounters[k].hash160s.load(std::memory_order_relaxed);
+        worker.matches = FCounters[k].matches.load(std::memory_order_relaxed);
+
+        report.keysTested += worker.keys;
+        report.hash160s += worker.hash160s;
+        report.matchesFound += worker.matches;
+    }
+
+    std::lock_guard<std::mutex> lock(FLock);
+
+    auto finished = report.running ? std::chrono::steady_clock::now() : FFinished;
+    report.elapsed = std::chrono::duration<double>(finished - FStarted).count();
+    report.keysPerSecond = report.elapsed > 0 ? (report.keysTested - FResumedKeys) / report.elapsed : 0;
+    report.hash160sPerSecond = report.elapsed > 0 ? (report.hash160s - FResumedHash160s) / report.elapsed : 0;
+    report.matches = FMatches;
+
+    // Hash160s miss P2TR and count a key once for P2PKH and P2WPKH, which
+    // are different addresses, and a point and its negation for P2TR,
+    // which are the same one. Addresses are comparable across kinds.
+    std::set<ADDRESS_TYPE> types;
+    for (size_t k = 0; k < FPatterns.Size(); k++)
+        types.insert(FPatterns.Pattern(k).Type());
+
+    double perKey = 0;
+    for (ADDRESS_TYPE type : types)
+        perKey += AddressesPerKey(type);
+    report.addresses = uint64_t(report.keysTested * perKey);
+    report.addressesPerSecond = report.keysPerSecond * perKey;
+
+    // Odds are counted in keys: a pattern whose kind gets a addresses per
+    // key needs complexity / a keys. Matching any pattern is as likely as
+    // matching one that needs 1 / sum(a / complexity) keys.
+    const double    tested = double(report.keysTested);
+    const double    rate = report.running ? report.keysPerSecond : 0;
+    double          anyRate = 0;
+
+    report.patterns.resize(FHits.size());
+    for (size_t k = 0; k < FHits.size(); k++) {
+        VanityPatternReport &pattern = report.patterns[k];
+
+        pattern.pattern = FPatterns.Pattern(k).Pattern();
+        pattern.complexity = FPatterns.Pattern(k).Complexity();
+        pattern.hits = FHits[k].load(std::memory_order_relaxed);
+
+        const double addresses = AddressesPerKey(FPatterns.Pattern(k).Type());
+        pattern.addressesPerKey = addresses;
+        const double keys = addresses > 0 ? pattern.complexity / addresses : std::numeric_limits<double>::infinity();
+        pattern.probability = matchProbability(tested, keys);
+        pattern.eta50 = matchEta(tested, keys, rate, 0.5);
+        pattern.eta90 = matchEta(tested, keys, rate, 0.9);
+
+        anyRate += addresses / pattern.complexity;
+    }
+
+    const double anyComplexity = anyRate > 0 ? 1 / anyRate : std::numeric_limits<double>::infinity();
+    report.probability = matchProbability(tested, anyComplexity);
+    report.eta50 = matchEta(tested, anyComplexity, rate, 0.5);
+    report.eta90 = matchEta(tested, anyComplexity, rate, 0.9);
+
+    return report;
+}
+
+std::string cosmyc::VanitySearch::ReportJson(const VanityReport &report)
+{
+    std::ostringstream ss;
+
+    ss << "{\"running\":" << (report.running ? "true" : "false")
+       << ",\"threads\":" << report.threads
+       << ",\"keys\":" << report.keysTested
+       << ",\"hash160s\":" << report.hash160s
+       << ",\"addresses\":" << report.addresses
+       << ",\"matchesFound\":" << report.matchesFound
+       << ",\"elapsed\":" << jsonNumber(report.elapsed)
+       << ",\"keysPerSecond\":" << jsonNumber(report.keysPerSecond)
+       << ",\"hash160sPerSecond\":" << jsonNumber(report.hash160sPerSecond)
+       << ",\"addressesPerSecond\":" << jsonNumber(report.addressesPerSecond)
+       << ",\"probability\":" << jsonNumber(report.probability)
+       << ",\"eta50\":" << jsonNumber(report.eta50)
+       << ",\"eta90\":" << jsonNumber(report.eta90);
+
+    ss << ",\"workers\":[";
+    for (size_t k = 0; k < report.workers.size(); k++) {
+        const VanityWorkerReport &worker = report.workers[k];
+        ss << (k ? "," : "")
+           << "{\"keys\":" << worker.keys
+           << ",\"hash160s\":" << worker.hash160s
+           << ",\"matches\":" << worker.matches << "}";
+    }
+
+    ss << "],\"patterns\":[";
+    for (size_t k = 0; k < report.patterns.size(); k++) {
+        const VanityPatternReport &pattern = report.patterns[k];
+        ss << (k ? "," : "")
+           << "{\"pattern\":" << jsonString(pattern.pattern)
+           << ",\"complexity\":" << jsonNumber(pattern.complexity)
+           << ",\"addressesPerKey\":" << jsonNumber(pattern.addressesPerKey)
+           << ",\"hits\":" << pattern.hits
+           << ",\"probability\":" << jsonNumber(pattern.probability)
+           << ",\"eta50\":" << jsonNumber(pattern.eta50)
+           << ",\"eta90\":" << jsonNumber(pattern.eta90) << "}";
+    }
+
+    // Private keys stay out of the dump, it is meant for monitoring
+    ss << "],\"matches\":[";
+    for (size_t k = 0; k < report.matches.size(); k++) {
+        ss << (k ? "," : "")
+           << "{\"pattern\":" << jsonString(report.matches[k].pattern)
+           << ",\"address\":" << jsonString(report.matches[k].address) << "}";
+    }
+    ss << "]}";
+
+    return ss.str();
+}
+
+double cosmyc::VanitySearch::AddressesPerKey(ADDRESS_TYPE type) const
+{
+    switch (type) {
+    case atP2WPKH:
+        return (FFormats & kfCompressed) ? 1 : 0;
+    case atP2TR:
+        // A point and its negation share the x-only key, see Worker()
+        return FSymmetries && FSplitKeyMode != skAdditive ? 0.5 : 1;
+    default:
+        return ((FFormats & kfUncompressed) ? 1 : 0) + ((FFormats & kfCompressed) ? 1 : 0);
+    }
+}
+
+void cosmyc::VanitySearch::Publish(
+            WorkerCounter           &counter,
+            uint64_t                steps,
+            uint64_t                keys,
+            uint64_t                hash160s,
+            std::vector<PendingHit> &pending)
+{
+    std::lock_guard<std::mutex> lock(FLock);
+
+    for (const auto &hit : pending) {
+        bool first = FHits[hit.pattern].fetch_add(1, std::memory_order_relaxed) == 0;
+        if (!hit.hasMatch || (FStopOnMatch && !first))
+            continue;
+
+        FMatches.push_back(hit.match);
+
+        if (FStopOnMatch && FUnmatched.fetch_sub(1) == 1)
+            FStop.store(true);
+    }
+
+    counter.matches.fetch_add(pending.size(), std::memory_order_relaxed);
+    counter.keys.fetch_add(keys, std::memory_order_relaxed);
+    counter.hash160s.fetch_add(hash160s, std::memory_order_relaxed);
+    counter.steps.store(steps, std::memory_order_relaxed);
+
+    pending.clear();
+}
+
+void cosmyc::VanitySearch::Check(
+    const   KeyWalker               &walker,
+            size_t                  entry,
+    const   unsigned char           *pubkey,
+            size_t                  pubkeyLen,
+    const   unsigned char           *hash160,
+            std::vector<size_t>     &matched,
+            std::vector<PendingHit> &pending)
+{
+    unsigned char   seckey[KeyWalker::PRIVATE_KEY_SIZE];
+
+    matched.clear();
+    if (!FPatterns.Match(hash160, matched))
+        return;
+
+    for (size_t pattern : matched) {
+        // P2WPKH is defined for compressed keys only, P2TR keys are
+        // checked without hashing
+        const ADDRESS_TYPE type = FPatterns.Pattern(pattern).Type();
+        if (type == atP2TR || (pubkeyLen != 33 && type == atP2WPKH))
+            continue;
+
+        PendingHit hit;
+
+        // With stopOnMatch, patterns that have their match are only counted
+        hit.pattern = pattern;
+        hit.hasMatch = !FStopOnMatch || FHits[pattern].load(std::memory_order_relaxed) == 0;
+
+        if (hit.hasMatch) {
+            walker.GetBatchPrivateKey(entry, seckey);
+
+            hit.match.pattern = FPatterns.Pattern(pattern).Pattern();
+            hit.match.address = FPatterns.Pattern(pattern).Address(hash160);
+            hit.match.privateKey = toHex(seckey, sizeof(seckey));
+            hit.match.publicKey = toHex(pubkey, pubkeyLen);
+            hit.match.splitKey = FSplitKeyMode;
+
+            memset(seckey, 0, sizeof(seckey));
+        }
+
+        pending.push_back(hit);
+    }
+}
+
+void cosmyc::VanitySearch::CheckTaproot(
+    const   KeyWalker               &walker,
+            size_t                  entry,
+    const   unsigned char           *pubkey,
+            std::vector<size_t>     &matched,
+            std::vector<PendingHit> &pending)
+{
+    unsigned char   seckey[KeyWalker::PRIVATE_KEY_SIZE];
+
+    // x follows the prefix byte in either serialization
+    const unsigned char *xonly = pubkey + 1;
+
+    matched.clear();
+    if (!FPatterns.Match(xonly, matched))
+        return;
+
+    for (size_t pattern : matched) {
+        if (FPatterns.Pattern(pattern).Type() != atP2TR)
+            continue;
+
+        PendingHit hit;
+
+        hit.pattern = pattern;
+        hit.hasMatch = !FStopOnMatch || FHits[pattern].load(std::memory_order_relaxed) == 0;
+
+        if (hit.hasMatch) {
+            // The key may have an odd y, BIP340 signing negates it then
+            walker.GetBatchPrivateKey(entry, seckey);
+
+            hit.match.pattern = FPatterns.Pattern(pattern).Pattern();
+            hit.match.address = FPatterns.Pattern(pattern).Address(xonly);
+            hit.match.privateKey = toHex(seckey, sizeof(seckey));
+            hit.match.publicKey = toHex(xonly, 32);
+            hit.match.splitKey = FSplitKeyMode;
+
+            memset(seckey, 0, sizeof(seckey));
+        }
+
+        pending.push_back(hit);
+    }
+}
+
+void cosmyc::VanitySearch::Worker(unsigned index)
+{
+    // Before anything is allocated, so it is allocated on this node
+    if (!FCpus.empty())
+        CpuTopology::Get().Pin(FCpus[index]);
+
+    WorkerCounter   &counter = FCounters[index];
+    KeyWalker       walker(FBatchSize);
+
+    walker.SetSymmetries(FSymmetries);
+
+    // With both formats the walker writes uncompressed keys and the
+    // compressed ones are cut from them. P2TR patterns alone need only
+    // x, i.e. compressed keys and no hashing.
+    const bool                  uncompressed = FHashPatterns && (FFormats & kfUncompressed) != 0;
+    const bool                  compressed = FHashPatterns && (FFormats & kfCompressed) != 0;
+    const size_t                formats = (uncompressed ? 1 : 0) + (compressed ? 1 : 0);
+    const size_t                stride = uncompressed ? 65 : 33;
+    std::vector<unsigned char>  pubkeys(walker.BatchEntries() * stride);
+
+    // A batch is hashed in one go, each format into its own array
+    std::vector<unsigned char>  compressedKeys(compressed && uncompressed ? walker.BatchEntries() * 33 : 0);
+    std::vector<unsigned char>  hashes(uncompressed ? walker.BatchEntries() * HASH160_OUTPUT_SIZE : 0);
+    std::vector<unsigned char>  compressedHashes(compressed ? walker.BatchEntries() * HASH160_OUTPUT_SIZE : 0);
+
+    // The odd symmetry variants are negations, with the same x as the
+    // entry before them
+    const size_t                taprootStep = walker.BatchEntries() / walker.BatchSize() > 1 ? 2 : 1;
+
+    unsigned char           seckey[KeyWalker::PRIVATE_KEY_SIZE];
+    std::vector<size_t>     matched;
+    std::vector<PendingHit> pending;
+
+    if (FSplitKeyMode == skAdditive)
+        walker.SetOffset(&FSplitKey[0], FSplitKey.size());
+    else if (FSplitKeyMode == skMultiplicative)
+        walker.SetBasePoint(&FSplitKey[0], FSplitKey.size());
+
+    // Continue the slice where the last published batch ended
+    toKey(FStarts[index], seckey);
+    walker.Reset(seckey, counter.steps.load(std::memory_order_relaxed));
+    memset(seckey, 0, sizeof(seckey));
+
+    const uint64_t limit = FLimits[index];
+
+    // The stop flag is checked once per batch
+    while (!FStop.load(std::memory_order_relaxed)) {
+        const uint64_t steps = walker.Steps();
+        if (limit != 0 && steps >= limit)
+            break;
+
+        size_t count = walker.NextBatch(&pubkeys[0], stride, !uncompressed);
+
+        // A bounded slice may end inside the batch
+        uint64_t walked = walker.Steps();
+        if (limit != 0 && walked > limit) {
+            count = size_t(limit - steps) * (count / size_t(walked - steps));
+            walked = limit;
+        }
+
+        // Points at infinity are hashed too and skipped below
+        if (compressed && uncompressed) {
+            for (size_t n = 0; n < count; n++)
+                KeyWalker::CompressPublicKey(&pubkeys[n * stride], &compressedKeys[n * 33]);
+            Hash160Batch(&compressedKeys[0], 33, count, &compressedHashes[0]);
+        } else if (compressed) {
+            Hash160Batch(&pubkeys[0], stride, count, &compressedHashes[0]);
+        }
+        if (uncompressed)
+            Hash160Batch(&pubkeys[0], stride, count, &hashes[0]);
+
+        for (size_t n = 0; n < count; n++) {
+            const unsigned char *pubkey = &pubkeys[n * stride];
+            if (pubkey[0] == 0)
+                continue;   // point at infinity
+
+            if (FTaprootPatterns && n % taprootStep == 0)
+                CheckTaproot(walker, n, pubkey, matched, pending);
+
+            if (uncompressed)
+                Check(walker, n, pubkey, 65, &hashes[n * HASH160_OUTPUT_SIZE], matched, pending);
+
+            if (compressed && uncompressed)
+                Check(walker, n, &compressedKeys[n * 33], 33, &compressedHashes[n * HASH160_OUTPUT_SIZE], matched, pending);
+            else if (compressed)
+                Check(walker, n, pubkey, 33, &compressedHashes[n * HASH160_OUTPUT_SIZE], matched, pending);
+        }
+
+        Publish(counter, walked, count, count * formats, pending);
+    }
+
+    if (FActive.fetch_sub(1) == 1) {
+        {
+            std::lock_guard<std::mutex> lock(FLock);
+            FFinished = std::chrono::steady_clock::now();
+        }
+
+        // Lets CheckpointWorker() take the final checkpoint
+        std::lock_guard<std::mutex> lock(FCheckpointLock);
+        FCheckpointWake.notify_all();
+    }
+}
+
+
+bool cosmyc::VanityCheckpoint::Save(const std::string &path) const
+{
+    const std::string temporary = path + ".tmp";
+
+    // Holds private keys of matches and the start scalars of the workers,
+    // see VanityCheckpoint
+    {
+        std::ostringstream file;
+
+        file << CHECKPOINT_MAGIC << " " << CHECKPOINT_VERSION << "\n"
+             << "formats " << int(formats) << "\n"
+             << "stoponmatch " << (stopOnMatch ? 1 : 0) << "\n"
+             << "batchsize " << batchSize << "\n"
+             << "symmetries " << (symmetries ? 1 : 0) << "\n"
+             << "splitkey " << int(splitKeyMode) << " "
+             << (splitKey.empty() ? std::string("-") : HexStr(splitKey)) << "\n";
+
+        for (size_t k = 0; k < patterns.size(); k++)
+            file << "pattern " << patterns[k] << " " << hits[k] << "\n";
+
+        for (const auto &worker : workers) {
+            file << "worker " << worker.start.GetHex() << " " << worker.steps
+                 << " " << worker.keys << " " << worker.hash160s << " " << worker.matches
+                 << " " << worker.limit << "\n";
+        }
+
+        for (const auto &match : matches) {
+            file << "match " << match.pattern << " " << match.address << " " << match.privateKey
+                 << " " << match.publicKey << " " << int(match.splitKey) << "\n";
+        }
+
+        if (!writePrivateFile(temporary, file.str()))
+            return false;
+    }
+
+    return replaceFile(temporary, path);
+}
+
+bool cosmyc::VanityCheckpoint::Load(const std::string &path)
+{
+    std::ifstream   file(path.c_str());
+    std::string     line;
+    std::string     magic;
+    int             version = 0;
+
+    if (!std::getline(file, line))
+        return false;
+
+    std::istringstream header(line);
+    if (!(header >> magic >> version) || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION)
+        return false;
+
+    *this = VanityCheckpoint();
+    formats = kfUncompressed;
+    stopOnMatch = true;
+    batchSize = KeyWalker::DEFAULT_BATCH_SIZE;
+    symmetries = false;
+    splitKeyMode = skNone;
+
+    while (std::getline(file, line)) {
+        std::istringstream  ss(line);
+        std::string         key;
+        int                 value = 0;
+
+        if (!(ss >> key))
+            continue;
+
+        // A damaged file is rejected, not loaded with values out of range
+        if (key == "formats") {
+            if (!(ss >> value) || value < kfUncompressed || value > kfBoth)
+                return false;
+            formats = KEY_FORMATS(value);
+        } else if (key == "stoponmatch") {
+            if (!(ss >> value))
+                return false;
+            stopOnMatch = value != 0;
+        } else if (key == "batchsize") {
+            if (!(ss >> batchSize))
+                return false;
+        } else if (key == "symmetries") {
+            if (!(ss >> value))
+                return false;
+            symmetries = value != 0;
+        } else if (key == "splitkey") {
+            std::string hex;
+            if (!(ss >> value >> hex) || value < skNone || value > skMultiplicative)
+                return false;
+            splitKeyMode = SPLIT_KEY_MODE(value);
+            splitKey = hex == "-" ? std::vector<unsigned char>() : ParseHex(hex);
+        } else if (key == "pattern") {
+            std::string pattern;
+            uint64_t    count = 0;
+            if (!(ss >> pattern >> count) || !VanityPattern::IsValid(pattern))
+                return false;
+            patterns.push_back(pattern);
+            hits.push_back(count);
+        } else if (key == "worker") {
+            Worker      worker;
+            std::string start;
+            if (!(ss >> start >> worker.steps >> worker.keys >> worker.hash160s >> worker.matches))
+                return false;
+            // Older checkpoints have no limit column
+            if (!(ss >> worker.limit))
+                worker.limit = 0;
+            worker.start.SetHex(start);
+            workers.push_back(worker);
+        } else if (key == "match") {
+            VanityMatch match;
+            if (!(ss >> match.pattern >> match.address >> match.privateKey >> match.publicKey >> value)
+                    || value < skNone || value > skMultiplicative)
+                return false;
+            match.splitKey = SPLIT_KEY_MODE(value);
+            matches.push_back(match);
+        } else {
+            return false;
+        }
+    }
+
+    return !patterns.empty() && !workers.empty();
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+#include "arith_uint256.h"
+#include "cputopology.h"
+#include "vanitypattern.h"
+
+namespace cosmyc {
+
+
+class KeyWalker;
+
+/// How the customer's key combines with the key found by a split-key search
+typedef enum _SPLIT_KEY_MODE
+{
+    skNone = 0,
+    skAdditive,         // final key = customer key + k
+    skMultiplicative    // final key = customer key * k
+} SPLIT_KEY_MODE;
+
+/// Public key serializations a search tests, each one is its own address
+typedef enum _KEY_FORMATS
+{
+    kfUncompressed  = 1,
+    kfCompressed    = 2,
+    kfBoth          = kfUncompressed | kfCompressed
+} KEY_FORMATS;
+
+/// One key whose address starts with the searched pattern
+struct VanityMatch
+{
+    std::string pattern;
+    std::string address;
+    std::string privateKey;     // hex, 32 bytes
+    std::string publicKey;      // hex, 33 or 65 bytes, 32 (x-only) for P2TR
+
+    /// Unless skNone, privateKey is only the partial key k of a split-key
+    /// search and the address belongs to the combined key
+    SPLIT_KEY_MODE  splitKey;
+};
+
+/// Progress of one pattern of a search.
+/// The odds follow from the complexity c: after N addresses of its kind a
+/// pattern has matched at least once with probability 1 - exp(-N/c). The ETAs are the
+/// seconds until that reaches 50% and 90% at the current rate, 0 once it
+/// has, and infinity while there is no rate yet.
+struct VanityPatternReport
+{
+    std::string pattern;
+    double      complexity;     // see Vanity::PatternComplexity
+    double      addressesPerKey;    // of its kind, 0.5 for P2TR with symmetries
+    uint64_t    hits;
+    double      probability;
+    double      eta50;
+    double      eta90;
+};
+
+/// Counters of one worker thread
+struct VanityWorkerReport
+{
+    uint64_t    keys;           // private keys (points and their symmetries)
+    uint64_t    hash160s;       // one per key and format, none for P2TR
+    uint64_t    matches;
+};
+
+/// Snapshot of a running (or finished) search
+struct VanityReport
+{
+    bool        running;
+    unsigned    threads;
+    uint64_t    keysTested;
+    uint64_t    hash160s;
+    uint64_t    addresses;      // distinct addresses of the pattern kinds
+    uint64_t    matchesFound;
+    double      elapsed;        // seconds since the last Start() or Resume()
+    double      keysPerSecond;  // rates of the work done in elapsed
+    double      hash160sPerSecond;
+    double      addressesPerSecond;
+
+    /// Odds of at least one match of any pattern, see VanityPatternReport
+    double      probability;
+    double      eta50;
+    double      eta90;
+
+    std::vector<VanityWorkerReport>     workers;
+    std::vector<VanityPatternReport>    patterns;
+    std::vector<VanityMatch>            matches;
+};
+
+/// Everything needed to continue a search exactly where it stopped.
+/// Worker k has tested the keys start .. start + steps - 1 of its slice
+/// and every match among them is in matches, so a resumed search neither
+/// repeats nor skips a key. A worker with a limit stops after that many
+/// points, which bounds the slice to start .. start + limit - 1.
+///
+/// A checkpoint is as secret as the keys it leads to: the private keys
+/// of the matches are in it, and anyone with a worker's start and steps
+/// can redo the search and find the same keys. Save() creates the file
+/// readable by the owner only (mode 0600 on POSIX). Keep copies equally
+/// private.
+struct VanityCheckpoint
+{
+    struct Worker
+    {
+        arith_uint256   start;      // private key the worker started at
+        uint64_t        steps;      // points walked from there
+        uint64_t        limit;      // slice length in points, 0 for no end
+        uint64_t        keys;
+        uint64_t        hash160s;
+        uint64_t        matches;
+    };
+
+    std::vector<std::string>    patterns;
+    KEY_FORMATS                 formats;
+    bool                        stopOnMatch;
+    size_t                      batchSize;
+    bool                        symmetries;
+    SPLIT_KEY_MODE              splitKeyMode;
+    std::vector<unsigned char>  splitKey;
+
+    std::vector<Worker>         workers;
+    std::vector<uint64_t>       hits;       // per pattern
+    std::vector<VanityMatch>    matches;
+
+    /// Writes a new file and renames it over path, so a crash while
+    /// saving never destroys the previous checkpoint
+    bool Save(const std::string &path) const;
+    bool Load(const std::string &path);
+};
+
+/// Multi-threaded base58 (P2PKH), bech32 (P2WPKH) and bech32m (P2TR)
+/// vanity address search.
+/// Any number of patterns of all kinds is compiled into one hash160
+/// lookup table (see VanityPatternSet), so every candidate is checked
+/// against all of them at once and never encoded unless it matches.
+///
+/// P2TR patterns are looked up with the x coordinate of the point as it
+/// comes out of the batch inversion. A search for P2TR patterns only
+/// computes no hash at all and is bound by the curve arithmetic alone;
+/// with symmetries it checks every other key, as P and -P share their x.
+/// Every worker walks its own random slice of the keyspace with a
+/// KeyWalker; nothing is shared between workers
+/// except the stop flag, the counters and the list of matches.
+///
+/// Testing both key formats costs one extra hash160 per point but no
+/// curve arithmetic: the compressed key is cut from the uncompressed one.
+///
+/// In split-key mode (SetSplitKey()) the workers search Q + k*G or k*Q
+/// for the customer's public key Q and only ever see the partial keys k,
+/// so the search can be handed to untrusted workers.
+///
+/// With a placement policy (SetPlacement()) every worker pins itself to
+/// its CPU before it allocates its walker and buffers, so they end up in
+/// the memory of its NUMA node.
+///
+/// Workers publish their progress once per batch, together with the
+/// matches of that batch, so Checkpoint() always sees a consistent state
+/// and only holds the lock for copying it.
+class VanitySearch
+{
+public:
+    VanitySearch();
+    ~VanitySearch();
+
+    /// Starts searching for addresses beginning with any of patterns.
+    /// threads == 0 means the default of the placement policy, one worker
+    /// per hardware thread unless it is ppPhysical.
+    /// With stopOnMatch the search ends once every pattern has a match
+    /// and only the first match of each pattern is kept.
+    /// Returns false if a pattern is not a valid P2PKH, P2WPKH or P2TR
+    /// prefix, a P2WPKH pattern comes without kfCompressed
+    /// or a search is already running.
+    bool Start(
+        const   std::vector<std::string>    &patterns,
+                unsigned                    threads     = 0,
+                KEY_FORMATS                 formats     = kfUncompressed,
+                bool                        stopOnMatch = true);
+
+    /// Single pattern search
+    bool Start(
+        const   std::string &pattern,
+                unsigned    threads     = 0,
+                KEY_FORMATS formats     = kfUncompressed,
+                bool        stopOnMatch = true);
+
+    /// Continues the search saved in checkpoint, with one worker per
+    /// saved worker. Returns false if it is not a valid checkpoint
+    /// or a search is already running.
+    bool Resume(const VanityCheckpoint &checkpoint);
+
+    /// Asks the workers to finish and waits for them.
+    void Stop();
+
+    /// State of the running (or last) search
+    VanityCheckpoint Checkpoint() const;
+
+    /// Saves a checkpoint to path every interval seconds while a search
+    /// runs and once more when it ends. An empty path turns it off.
+    /// Takes effect on the next Start() or Resume().
+    void SetAutoCheckpoint(const std::string &path, unsigned interval);
+
+    /// Number of keys every worker converts to affine coordinates at
+    /// once, see KeyWalker. Takes effect on the next Start().
+    void SetBatchSize(size_t batchSize);
+
+    /// Also test the five companions of every computed point (negation
+    /// and the endomorphism images, see KeyWalker::SetSymmetries()).
+    /// Makes the search almost entirely hash-bound.
+    /// Takes effect on the next Start().
+    void SetSymmetries(bool enabled);
+
+    /// How workers are pinned to CPUs, see CpuTopology::Placement().
+    /// Takes effect on the next Start() or Resume().
+    void SetPlacement(PLACEMENT_POLICY policy);
+
+    /// Customer public key (hex) for a split-key search, empty for a
+    /// plain search. Takes effect on the next Start().
+    /// Returns false (and keeps the previous key) if it does not parse.
+    bool SetSplitKey(
+        const   std::string     &publicKey,
+                SPLIT_KEY_MODE  mode = skAdditive);
+
+    bool IsRunning() const;
+
+    /// Reads the counters without stopping or locking out the workers
+    VanityReport Report() const;
+
+    /// report as a JSON object, for scripts and monitoring
+    static std::string ReportJson(const VanityReport &report);
+
+private:
+    /// Per-worker counters, kept on their own cache line so workers
+    /// never write to a line another worker reads
+    struct alignas(64) WorkerCounter
+    {
+        std::atomic<uint64_t>   steps;
+        std::atomic<uint64_t>   keys;
+        std::atomic<uint64_t>   hash160s;
+        std::atomic<uint64_t>   matches;
+    };
+
+    /// A hit of a batch that is not published yet
+    struct PendingHit
+    {
+        size_t      pattern;
+        bool        hasMatch;   // false for a known pattern in stopOnMatch mode
+        VanityMatch match;
+    };
+
+    void Worker(unsigned index);
+    void CheckpointWorker();
+
+    /// Looks up the hash160 of one serialized key of the walker's last
+    /// batch (entry) and appends a hit to pending for every pattern it
+    /// matches
+    void Check(
+        const   KeyWalker               &walker,
+                size_t                  entry,
+        const   unsigned char           *pubkey,
+                size_t                  pubkeyLen,
+        const   unsigned char           *hash160,
+                std::vector<size_t>     &matched,
+                std::vector<PendingHit> &pending);
+
+    /// Looks up the x-only key of entry (the x coordinate of a serialized
+    /// key) in the P2TR patterns, no hashing involved
+    void CheckTaproot(
+        const   KeyWalker               &walker,
+                size_t                  entry,
+        const   unsigned char           *pubkey,
+                std::vector<size_t>     &matched,
+                std::vector<PendingHit> &pending);
+
+    /// Addresses of pattern type a search tests per key, i.e. per entry
+    /// of a batch
+    double AddressesPerKey(ADDRESS_TYPE type) const;
+
+    /// Makes a finished batch visible: its hits, matches and counters
+    /// together with the new step count
+    void Publish(
+                WorkerCounter           &counter,
+                uint64_t                steps,
+                uint64_t                keys,
+                uint64_t                hash160s,
+                std::vector<PendingHit> &pending);
+
+    VanityPatternSet            FPatterns;
+    bool                        FHashPatterns;      // any P2PKH or P2WPKH
+    bool                        FTaprootPatterns;   // any P2TR
+    KEY_FORMATS                 FFormats;
+    bool                        FStopOnMatch;
+    size_t                      FBatchSize;
+    bool                        FSymmetries;
+    std::vector<unsigned char>  FSplitKey;
+    SPLIT_KEY_MODE              FSplitKeyMode;
+    std::vector<arith_uint256>  FStarts;    // per worker
+    std::vector<uint64_t>       FLimits;    // per worker, 0 for no end
+    PLACEMENT_POLICY            FPlacement;
+    std::vector<unsigned>       FCpus;      // per worker, empty if not pinned
+    std::vector<std::string>    FPatternList;
+
+    std::string                 FCheckpointPath;
+    unsigned                    FCheckpointInterval;
+    std::thread                 FCheckpointThread;
+    std::mutex                  FCheckpointLock;
+    std::condition_variable     FCheckpointWake;
+
+    std::vector<std::thread>                FThreads;
+    std::vector<WorkerCounter>              FCounters;
+    std::vector<std::atomic<uint64_t> >     FHits;      // per pattern, written under FLock
+    std::atomic<size_t>                     FUnmatched; // patterns without a hit
+    std::atomic<bool>                       FStop;
+    std::atomic<unsigned>                   FActive;
+
+    std::chrono::steady_clock::time_point   FStarted;
+    std::chrono::steady_clock::time_point   FFinished;
+    uint64_t                                FResumedKeys;       // counted before FStarted,
+    uint64_t                                FResumedHash160s;   // not part of the rates
+
+    mutable std::mutex          FLock;
+    std::vector<VanityMatch>    FMatches;
+};
+
+
+} // namespace cosmyc